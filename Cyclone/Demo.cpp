@@ -1,6 +1,11 @@
 #include "Core/Stopwatch.h"
 #include "Threading/JobSystem.h"
 
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <thread>
+
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
@@ -12,6 +17,8 @@ using namespace Core;
 void CameraUnitTest(uint32_t cameraCount);
 void TransformUnitTest(uint32_t transformCount);
 void SpinUnitTest(float milliseconds);
+bool TopologyUnitTest();
+bool SchedulingUnitTest();
 
 struct Data
 {
@@ -26,13 +33,27 @@ struct Data
     }
 };
 
-int main(int argc, int argv[])
+int main(int argc, char* argv[])
 {
     CYCLONE_UNREFERENCED_PARAMETER(argc);
     CYCLONE_UNREFERENCED_PARAMETER(argv);
 
     Cyclone::Initialize();
 
+    // Topology Test: Core Placement and Steal Orders
+    if (!TopologyUnitTest())
+    {
+        Cyclone::Shutdown();
+        return 1;
+    }
+
+    // Scheduling Test: Ordering and Accounting Guarantees
+    if (!SchedulingUnitTest())
+    {
+        Cyclone::Shutdown();
+        return 1;
+    }
+
     // Serial Test: Simple Loops
     {
         Stopwatch T = Stopwatch("Serial Test (Ticking Counters)");
@@ -80,21 +101,22 @@ int main(int argc, int argv[])
 
     // Dispatch Test 1: Simple Loops
     {
-        Data* dataSet = new Data[dataCount];
+        // Constructed by the workers that process it below, so its pages sit on their NUMA nodes.
+        const uint32_t groupSize = 128;
+        Data* dataSet = Cyclone::ParallelAllocate<Data>(dataCount, groupSize);
 
         {
             Cyclone::Context loopContext;
             Stopwatch T = Stopwatch("Dispatch Test (Simple Loops)");
 
-            const uint32_t groupSize = 128;
             Cyclone::Dispatch(loopContext, dataCount, groupSize, [&dataSet](Cyclone::JobArguments arguments)
             {
-                dataSet[arguments.m_JobGroupIndex].Compute();
+                dataSet[arguments.m_JobIndex].Compute();
             });
             Cyclone::Wait(loopContext);
         }
 
-        delete[] dataSet;
+        Cyclone::ParallelFree(dataSet, dataCount);
     }
 
     // Dispatch Test 2: Camera Matrices (1500000 Camera Updates)
@@ -103,6 +125,7 @@ int main(int argc, int argv[])
     // Dispatch Test 3: Entity Transforms (1500000 Transform Updates)
     TransformUnitTest(dataCount);
 
+    Cyclone::Shutdown();
     return 0;
 }
 
@@ -202,4 +225,360 @@ void SpinUnitTest(float milliseconds)
         std::chrono::duration<double> timeSpan = std::chrono::duration_cast<std::chrono::duration<double>>(timePoint2 - timePoint1);
         ms = timeSpan.count();
     }
-}
\ No newline at end of file
+}
+
+// A logical core of a fake sysfs tree.
+struct FakeCore
+{
+    std::string m_Siblings;         // thread_siblings_list
+    std::string m_L3Cores;          // shared_cpu_list of the L3. Left out if empty.
+    uint32_t m_PackageID = 0;
+    uint32_t m_MaxFrequency = 0;    // cpuinfo_max_freq in kHz. Left out if zero.
+};
+
+static void WriteSysfsFile(const std::filesystem::path& filePath, const std::string& contents)
+{
+    std::filesystem::create_directories(filePath.parent_path());
+    std::ofstream(filePath) << contents << "\n";
+}
+
+// Lays out the cores in the format the kernel uses under /sys/devices/system. NodeCores holds the cpulist of each NUMA node, if any.
+static void WriteFakeTopology(const std::filesystem::path& sysfsRoot, const std::vector<FakeCore>& cores, const std::vector<std::string>& nodeCores)
+{
+    std::filesystem::remove_all(sysfsRoot);
+    WriteSysfsFile(sysfsRoot / "cpu" / "online", "0-" + std::to_string(cores.size() - 1));
+    for (size_t core = 0; core < cores.size(); core++)
+    {
+        const std::filesystem::path coreRoot = sysfsRoot / "cpu" / ("cpu" + std::to_string(core));
+        if (!cores[core].m_Siblings.empty())
+        {
+            WriteSysfsFile(coreRoot / "topology" / "thread_siblings_list", cores[core].m_Siblings);
+            WriteSysfsFile(coreRoot / "topology" / "physical_package_id", std::to_string(cores[core].m_PackageID));
+        }
+        if (!cores[core].m_L3Cores.empty())
+        {
+            WriteSysfsFile(coreRoot / "cache" / "index0" / "level", "2");
+            WriteSysfsFile(coreRoot / "cache" / "index0" / "shared_cpu_list", cores[core].m_Siblings);
+            WriteSysfsFile(coreRoot / "cache" / "index1" / "level", "3");
+            WriteSysfsFile(coreRoot / "cache" / "index1" / "shared_cpu_list", cores[core].m_L3Cores);
+        }
+        if (cores[core].m_MaxFrequency != 0)
+        {
+            WriteSysfsFile(coreRoot / "cpufreq" / "cpuinfo_max_freq", std::to_string(cores[core].m_MaxFrequency));
+        }
+    }
+
+    if (!nodeCores.empty())
+    {
+        WriteSysfsFile(sysfsRoot / "node" / "online", "0-" + std::to_string(nodeCores.size() - 1));
+        for (size_t nodeID = 0; nodeID < nodeCores.size(); nodeID++)
+        {
+            WriteSysfsFile(sysfsRoot / "node" / ("node" + std::to_string(nodeID)) / "cpulist", nodeCores[nodeID]);
+        }
+    }
+}
+
+static bool CheckCores(const std::string& description, const std::vector<uint32_t>& cores, const std::vector<uint32_t>& expectedCores)
+{
+    if (cores == expectedCores)
+    {
+        return true;
+    }
+
+    std::cout << "Topology Test failed, " << description << ":";
+    for (uint32_t core : cores)
+    {
+        std::cout << " " << core;
+    }
+    std::cout << std::endl;
+    return false;
+}
+
+// Schedulers are created on fake trees, which leave out the affinity of the process, so the results don't depend on the machine running the test.
+bool TopologyUnitTest()
+{
+    using Cyclone::Priority;
+    const std::filesystem::path testRoot = std::filesystem::temp_directory_path() / "CycloneTopologyTest";
+    bool isPassed = true;
+
+    // Hybrid: four performance cores with two threads each, the second one boosting higher, and eight efficiency cores, all sharing one L3.
+    {
+        std::vector<FakeCore> cores;
+        for (uint32_t core = 0; core < 16; core++)
+        {
+            const bool isPerformanceCore = core < 8;
+            const uint32_t physicalCore = isPerformanceCore ? core & ~1u : core;
+            const std::string siblings = isPerformanceCore ? std::to_string(physicalCore) + "-" + std::to_string(physicalCore + 1) : std::to_string(core);
+            cores.push_back({ siblings, "0-15", 0, !isPerformanceCore ? 4200000u : physicalCore == 2 ? 5800000u : 5400000u });
+        }
+        WriteFakeTopology(testRoot / "Hybrid", cores, {});
+        Cyclone::SetTopologyRoot((testRoot / "Hybrid").string());
+
+        Cyclone::Scheduler scheduler;
+        isPassed &= CheckCores("hybrid high priority cores", scheduler.GetPoolCores(Priority::High), { 0, 2, 4, 6 });
+        isPassed &= CheckCores("hybrid low priority cores", scheduler.GetPoolCores(Priority::Low), { 0, 8, 9, 10, 11, 12, 13, 14, 2, 4, 6, 15 });
+        isPassed &= CheckCores("hybrid streaming cores", scheduler.GetPoolCores(Priority::Streaming), { 8, 9, 10, 11, 12, 13, 14, 15 });
+        isPassed &= CheckCores("hybrid high priority steal order", scheduler.GetStealOrder(Priority::High, 1), { 1, 2, 0 });
+
+        // Thieves on performance cores go for the efficiency cores first, whose backlog drains the slowest.
+        isPassed &= CheckCores("hybrid low priority steal order", scheduler.GetStealOrder(Priority::Low, 8), { 8, 0, 1, 2, 3, 4, 5, 6, 9, 7 });
+    }
+
+    // Two sockets, each a NUMA node of two L3s shared by two cores with two threads each.
+    {
+        std::vector<FakeCore> cores;
+        for (uint32_t core = 0; core < 16; core++)
+        {
+            const uint32_t physicalCore = core & ~1u;
+            const uint32_t firstL3Core = core & ~3u;
+            cores.push_back({ std::to_string(physicalCore) + "-" + std::to_string(physicalCore + 1), std::to_string(firstL3Core) + "-" + std::to_string(firstL3Core + 3), core / 8 });
+        }
+        WriteFakeTopology(testRoot / "TwoSockets", cores, { "0-7", "8-15" });
+        Cyclone::SetTopologyRoot((testRoot / "TwoSockets").string());
+
+        Cyclone::Scheduler scheduler;
+        for (Priority priority : { Priority::High, Priority::Low, Priority::Streaming })
+        {
+            isPassed &= CheckCores("two socket pool cores", scheduler.GetPoolCores(priority), { 0, 2, 4, 6, 8, 10, 12, 14 });
+        }
+
+        // Workers on cores 8 through 14. Those sharing an L3 come first, then the node, then the other socket.
+        isPassed &= CheckCores("two socket steal order", scheduler.GetStealOrder(Priority::High, 3), { 3, 4, 5, 6, 0, 1, 2 });
+        isPassed &= CheckCores("two socket steal order", scheduler.GetStealOrder(Priority::High, 5), { 5, 6, 3, 4, 0, 1, 2 });
+
+        // Without NUMA information, every core is on node 0. The socket still keeps the other half away.
+        WriteFakeTopology(testRoot / "TwoSocketsWithoutNodes", cores, {});
+        Cyclone::SetTopologyRoot((testRoot / "TwoSocketsWithoutNodes").string());
+
+        Cyclone::Scheduler schedulerWithoutNodes;
+        isPassed &= CheckCores("two socket steal order without nodes", schedulerWithoutNodes.GetStealOrder(Priority::High, 5), { 5, 6, 3, 4, 0, 1, 2 });
+    }
+
+    // Flat: nothing but the online cores, as on machines exposing no topology. Every core is a physical core of its own, all sharing one L3.
+    {
+        WriteFakeTopology(testRoot / "Flat", std::vector<FakeCore>(8), {});
+        Cyclone::SetTopologyRoot((testRoot / "Flat").string());
+
+        Cyclone::Scheduler scheduler;
+        isPassed &= CheckCores("flat pool cores", scheduler.GetPoolCores(Priority::High), { 0, 1, 2, 3, 4, 5, 6, 7 });
+        isPassed &= CheckCores("flat steal order", scheduler.GetStealOrder(Priority::High, 2), { 2, 3, 4, 5, 6, 0, 1 });
+    }
+
+    // Wide: more cores than a 64 bit mask could address, of which the scheduler is given a few past the 64th.
+    {
+        WriteFakeTopology(testRoot / "Wide", std::vector<FakeCore>(128), {});
+        Cyclone::SetTopologyRoot((testRoot / "Wide").string());
+
+        Cyclone::Scheduler scheduler(~0u, { 100, 64, 127, 65 });
+        isPassed &= CheckCores("wide pool cores", scheduler.GetPoolCores(Priority::High), { 64, 65, 100, 127 });
+    }
+
+    Cyclone::SetTopologyRoot("/sys/devices/system");
+    std::filesystem::remove_all(testRoot);
+
+    std::cout << "Topology Test: " << (isPassed ? "Passed" : "Failed") << "\n\n";
+    return isPassed;
+}
+
+static bool CheckScheduling(const std::string& description, bool isPassed)
+{
+    if (!isPassed)
+    {
+        std::cout << "Scheduling Test failed, " << description << std::endl;
+    }
+    return isPassed;
+}
+
+// Each check runs on a scheduler of its own, so limits and policies don't leak into the other tests.
+bool SchedulingUnitTest()
+{
+    bool isPassed = true;
+
+    // Strands: tasks run one at a time, in the order they were added.
+    {
+        Cyclone::Scheduler scheduler(4);
+        Cyclone::Context strandContext;
+        strandContext.m_Scheduler = &scheduler;
+        Cyclone::Strand strand(strandContext);
+
+        std::vector<uint32_t> order;
+        for (uint32_t i = 0; i < 1000; i++)
+        {
+            Cyclone::Execute(strand, [&order, i](Cyclone::JobArguments) { order.push_back(i); });
+        }
+        Cyclone::Wait(strandContext);
+
+        bool isInOrder = order.size() == 1000;
+        for (uint32_t i = 0; isInOrder && i < 1000; i++)
+        {
+            isInOrder = order[i] == i;
+        }
+        isPassed &= CheckScheduling("strand order", isInOrder);
+    }
+
+    // Backpressure: under FailFast, submissions beyond the total capacity are turned away, and everything admitted shows up in the queue depth.
+    {
+        Cyclone::Scheduler scheduler(4);
+        Cyclone::Context blockedContext;
+        blockedContext.m_Priority = Cyclone::Priority::Low;
+        blockedContext.m_Scheduler = &scheduler;
+
+        // Keep every worker of the pool busy, so nothing is taken off the queues while they fill up.
+        const uint32_t threadCount = scheduler.GetThreadCount(Cyclone::Priority::Low);
+        std::atomic<uint32_t> blockedCount = 0;
+        std::atomic<bool> isReleased = false;
+        for (uint32_t i = 0; i < threadCount; i++)
+        {
+            Cyclone::Execute(blockedContext, [&](Cyclone::JobArguments)
+            {
+                blockedCount++;
+                while (!isReleased)
+                {
+                    std::this_thread::yield();
+                }
+            });
+        }
+        while (blockedCount < threadCount)
+        {
+            std::this_thread::yield();
+        }
+
+        scheduler.SetQueueLimits(Cyclone::Priority::Low, 2, 4, Cyclone::BackpressurePolicy::FailFast);
+        Cyclone::Context limitedContext;
+        limitedContext.m_Priority = Cyclone::Priority::Low;
+        limitedContext.m_Scheduler = &scheduler;
+        std::atomic<uint32_t> executedCount = 0;
+        uint32_t submittedCount = 0;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            submittedCount += Cyclone::Execute(limitedContext, [&executedCount](Cyclone::JobArguments) { executedCount++; }) == Cyclone::SubmitStatus::Submitted;
+        }
+        isPassed &= CheckScheduling("fail fast admits the total capacity", submittedCount == 4);
+        isPassed &= CheckScheduling("queue depth under limits", scheduler.GetQueueDepth(Cyclone::Priority::Low) == 4);
+
+        isReleased = true;
+        Cyclone::Wait(limitedContext);
+        Cyclone::Wait(blockedContext);
+        isPassed &= CheckScheduling("admitted jobs executed", executedCount == submittedCount);
+        isPassed &= CheckScheduling("queue depth once drained", scheduler.GetQueueDepth(Cyclone::Priority::Low) == 0);
+    }
+
+    // Coalescing: tiny jobs queued behind busy workers are merged into batches. Every payload must run exactly once, and count as queued until it does.
+    {
+        Cyclone::Scheduler scheduler(4);
+        Cyclone::Context blockedContext;
+        blockedContext.m_Scheduler = &scheduler;
+
+        const uint32_t threadCount = scheduler.GetThreadCount();
+        std::atomic<uint32_t> blockedCount = 0;
+        std::atomic<bool> isReleased = false;
+        for (uint32_t i = 0; i < threadCount; i++)
+        {
+            Cyclone::Execute(blockedContext, [&](Cyclone::JobArguments)
+            {
+                blockedCount++;
+                while (!isReleased)
+                {
+                    std::this_thread::yield();
+                }
+            });
+        }
+        while (blockedCount < threadCount)
+        {
+            std::this_thread::yield();
+        }
+
+        const uint32_t tinyJobCount = 1000;
+        std::unique_ptr<std::atomic<uint32_t>[]> executionCounts(new std::atomic<uint32_t>[tinyJobCount]);
+        Cyclone::Context tinyContext;
+        tinyContext.m_Scheduler = &scheduler;
+        tinyContext.m_CostHint = std::chrono::microseconds(1);
+        for (uint32_t i = 0; i < tinyJobCount; i++)
+        {
+            executionCounts[i] = 0;
+            Cyclone::Execute(tinyContext, [&executionCounts, i](Cyclone::JobArguments) { executionCounts[i]++; });
+        }
+        isPassed &= CheckScheduling("queue depth counts coalesced jobs", scheduler.GetQueueDepth() == tinyJobCount);
+
+        isReleased = true;
+        Cyclone::Wait(tinyContext);
+        Cyclone::Wait(blockedContext);
+        bool isExecutedOnce = true;
+        for (uint32_t i = 0; i < tinyJobCount; i++)
+        {
+            isExecutedOnce &= executionCounts[i] == 1;
+        }
+        isPassed &= CheckScheduling("coalesced jobs executed exactly once", isExecutedOnce);
+        isPassed &= CheckScheduling("queue depth once coalesced jobs drained", scheduler.GetQueueDepth() == 0);
+    }
+
+    // Group reductions: both the shared total and the per group results add up to the sum of the job indices.
+    {
+        Cyclone::Scheduler scheduler(4);
+        Cyclone::Context reduceContext;
+        reduceContext.m_Scheduler = &scheduler;
+
+        const uint32_t jobCount = 1000;
+        const uint32_t groupSize = 64;
+        const uint64_t expectedTotal = uint64_t(jobCount) * (jobCount - 1) / 2;
+        std::atomic<uint64_t> total = 0;
+        std::vector<uint64_t> groupResults(Cyclone::GetDispatchGroupCount(jobCount, groupSize), 0);
+        Cyclone::Dispatch(reduceContext, jobCount, groupSize, [&](Cyclone::JobArguments arguments)
+        {
+            Cyclone::ReduceInGroup<uint64_t>(arguments, arguments.m_JobIndex, total, std::plus<uint64_t>());
+        }, sizeof(uint64_t));
+        Cyclone::Dispatch(reduceContext, jobCount, groupSize, [&](Cyclone::JobArguments arguments)
+        {
+            Cyclone::ReduceInGroup<uint64_t>(arguments, arguments.m_JobIndex, groupResults.data(), std::plus<uint64_t>());
+        }, sizeof(uint64_t));
+        Cyclone::Wait(reduceContext);
+
+        uint64_t groupTotal = 0;
+        for (uint64_t groupResult : groupResults)
+        {
+            groupTotal += groupResult;
+        }
+        isPassed &= CheckScheduling("reduction into a shared total", total == expectedTotal);
+        isPassed &= CheckScheduling("reduction into group results", groupTotal == expectedTotal);
+
+        // Alignments that aren't a power of two are rounded up, and sizes JobArguments can't describe are turned away.
+        std::atomic<bool> isAligned = true;
+        Cyclone::Dispatch(reduceContext, 64, 8, [&isAligned](Cyclone::JobArguments arguments)
+        {
+            isAligned = isAligned && reinterpret_cast<uintptr_t>(arguments.m_SharedMemory) % 64 == 0;
+        }, 16, 48);
+        Cyclone::Dispatch(reduceContext, 64, 8, [&isAligned](Cyclone::JobArguments arguments)
+        {
+            isAligned = isAligned && arguments.m_SharedMemory != nullptr;
+        }, 16, 0);
+        Cyclone::Wait(reduceContext);
+        isPassed &= CheckScheduling("shared memory alignment rounded up", isAligned);
+        isPassed &= CheckScheduling("oversized shared memory rejected", sizeof(size_t) == sizeof(uint32_t) ||
+                                    Cyclone::Dispatch(reduceContext, 1, 1, [](Cyclone::JobArguments) { }, size_t(UINT32_MAX) + 1) == Cyclone::SubmitStatus::InvalidArgument);
+    }
+
+    // Delayed jobs: the job runs once, no earlier than its delay, and keeps its context busy until then.
+    {
+        Cyclone::Scheduler scheduler(4);
+        Cyclone::Context delayedContext;
+        delayedContext.m_Scheduler = &scheduler;
+
+        const Cyclone::Duration delay = std::chrono::milliseconds(20);
+        const Cyclone::TimePoint submitTime = std::chrono::steady_clock::now();
+        std::atomic<uint32_t> executedCount = 0;
+        Cyclone::TimePoint executionTime;
+        Cyclone::ExecuteAfter(delayedContext, delay, [&](Cyclone::JobArguments)
+        {
+            executionTime = std::chrono::steady_clock::now();
+            executedCount++;
+        });
+        isPassed &= CheckScheduling("context busy until the delayed job ran", Cyclone::IsBusy(delayedContext));
+
+        Cyclone::Wait(delayedContext);
+        isPassed &= CheckScheduling("delayed job executed once", executedCount == 1);
+        isPassed &= CheckScheduling("delayed job not early", executionTime - submitTime >= delay);
+    }
+
+    std::cout << "Scheduling Test: " << (isPassed ? "Passed" : "Failed") << "\n\n";
+    return isPassed;
+}
@@ -0,0 +1,131 @@
+#include "JobServer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+namespace Cyclone
+{
+    // The value of the last jobserver option in MAKEFLAGS, as make passes the options of outer makes on, followed by its own.
+    static std::string FindJobServerAuth(const std::string& makeFlags)
+    {
+        for (const char* option : { "--jobserver-auth=", "--jobserver-fds=" })
+        {
+            const size_t optionBegin = makeFlags.rfind(option);
+            if (optionBegin != std::string::npos)
+            {
+                const size_t valueBegin = optionBegin + strlen(option);
+                return makeFlags.substr(valueBegin, makeFlags.find(' ', valueBegin) - valueBegin);
+            }
+        }
+        return std::string();
+    }
+
+#ifdef _WIN32
+    JobServer::~JobServer()
+    {
+        if (m_Semaphore != nullptr)
+        {
+            CloseHandle(m_Semaphore);
+        }
+    }
+
+    bool JobServer::Connect(const char* makeFlags)
+    {
+        const std::string semaphoreName = FindJobServerAuth(makeFlags != nullptr ? makeFlags : "");
+        if (semaphoreName.empty())
+        {
+            return false;
+        }
+
+        m_Semaphore = OpenSemaphoreA(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, semaphoreName.c_str());
+        return m_Semaphore != nullptr;
+    }
+
+    bool JobServer::IsConnected() const
+    {
+        return m_Semaphore != nullptr;
+    }
+
+    bool JobServer::Acquire(char& token, Duration timeout)
+    {
+        token = '+'; // Semaphores carry no token values.
+        const DWORD timeoutMilliseconds = (DWORD)std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+        return WaitForSingleObject(m_Semaphore, timeoutMilliseconds) == WAIT_OBJECT_0;
+    }
+
+    void JobServer::Release(char token)
+    {
+        CYCLONE_UNREFERENCED_PARAMETER(token);
+        ReleaseSemaphore(m_Semaphore, 1, nullptr);
+    }
+#else
+    JobServer::~JobServer()
+    {
+        if (m_ReadFD >= 0)
+        {
+            close(m_ReadFD);
+        }
+    }
+
+    bool JobServer::Connect(const char* makeFlags)
+    {
+        const std::string jobServerAuth = FindJobServerAuth(makeFlags != nullptr ? makeFlags : "");
+        if (jobServerAuth.empty())
+        {
+            return false;
+        }
+
+        if (jobServerAuth.compare(0, 5, "fifo:") == 0)
+        {
+            m_ReadFD = open(jobServerAuth.c_str() + 5, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+            m_WriteFD = m_ReadFD;
+            return m_ReadFD >= 0;
+        }
+
+        int inheritedReadFD = -1;
+        int inheritedWriteFD = -1;
+        struct stat readStatus = {};
+        if (sscanf(jobServerAuth.c_str(), "%d,%d", &inheritedReadFD, &inheritedWriteFD) != 2 || fstat(inheritedReadFD, &readStatus) != 0 || !S_ISFIFO(readStatus.st_mode))
+        {
+            return false; // Make closes the descriptors for recipes it doesn't consider recursive, and they may have been reused since.
+        }
+
+        // The inherited end of the pipe blocks, and is shared with make and its other children, so marking it as non-blocking would affect them too.
+        // Reopening it gives us our own non-blocking handle, so a token taken by another process between poll() and read() can't leave a worker stuck.
+        const std::string readPath = "/proc/self/fd/" + std::to_string(inheritedReadFD);
+        m_ReadFD = open(readPath.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        m_WriteFD = inheritedWriteFD;
+        return m_ReadFD >= 0;
+    }
+
+    bool JobServer::IsConnected() const
+    {
+        return m_ReadFD >= 0;
+    }
+
+    bool JobServer::Acquire(char& token, Duration timeout)
+    {
+        pollfd readPoll = { m_ReadFD, POLLIN, 0 };
+        const int timeoutMilliseconds = (int)std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+        return poll(&readPoll, 1, timeoutMilliseconds) > 0 && read(m_ReadFD, &token, 1) == 1;
+    }
+
+    void JobServer::Release(char token)
+    {
+        while (write(m_WriteFD, &token, 1) < 0 && errno == EINTR)
+        {
+        }
+    }
+#endif
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "JobSystem.h"
+
+namespace Cyclone
+{
+    // Client of the GNU make jobserver, through which make and the tools it runs share a fixed number of job slots. Each process owns one slot implicitly,
+    // and any concurrency beyond that takes a token from the jobserver, which is handed back once done. Tokens must be returned as they were read.
+    struct JobServer
+    {
+        ~JobServer();
+
+        // Connects to the jobserver advertised in MAKEFLAGS: an inherited pipe passed as --jobserver-auth=R,W (--jobserver-fds=R,W before make 4.2),
+        // a named pipe passed as --jobserver-auth=fifo:PATH, or a named semaphore on Windows. Returns false if there is none, such as when not
+        // started by make with -j, or from a recipe make didn't mark as recursive.
+        bool Connect(const char* makeFlags);
+        bool IsConnected() const;
+
+        // Waits up to the timeout for a token. Tokens can be taken by other processes between being signalled and read, so this may fail early.
+        bool Acquire(char& token, Duration timeout);
+        void Release(char token);
+
+        int m_ReadFD = -1;              // Opened by us. See Connect().
+        int m_WriteFD = -1;             // Inherited from make, or the same as the read end for named pipes.
+        void* m_Semaphore = nullptr;    // Windows only.
+    };
+}
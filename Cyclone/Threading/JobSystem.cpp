@@ -1,12 +1,22 @@
 #include "JobSystem.h"
+#include "TimerWheel.h"
+#include "ThreadPlatform.h"
+#include "Topology.h"
+#include "JobServer.h"
+#include "LinearArena.h"
+#include "SizeClassAllocator.h"
 
 #include <thread>
-#include <windows.h>
+#include <mutex>
+#include <vector>
 #include <sstream>
 #include <assert.h>
-#include <winerror.h>
 #include <deque>
 #include <iostream>
+#include <typeinfo>
+#include <tuple>
+#include <cstdlib>
+#include <cstring>
 
 namespace Cyclone
 {
@@ -15,48 +25,80 @@ namespace Cyclone
     {
         std::function<void(JobArguments)> m_Task;
         Context* m_Context = nullptr; // The execution context which the job belongs to.
+        JobClass* m_JobClass = nullptr;
         uint32_t m_GroupID = 0;
         uint32_t m_GroupJobOffset = 0;
         uint32_t m_GroupJobEnd = 0;
         uint32_t m_SharedMemorySize = 0;
+        uint32_t m_SharedMemoryAlignment = DefaultSharedMemoryAlignment;
+        bool m_IsSharedMemoryZeroed = false;
+        TimePoint m_Deadline = NoDeadline;
+        TimePoint m_SchedulingKey = NoDeadline; // Ready jobs are ordered by this. Either the deadline or the aged submission time.
+        uint64_t m_QueueSequence = 0;           // Order of insertion into its queue, which breaks ties between equal keys.
 
-        void Execute()
+        void Execute();
+    };
+
+    // Queued jobs are pushed and popped by different workers, so their storage comes from the size class caches rather than the global heap.
+    using JobDeque = std::deque<Job, SizeClassAllocator<Job>>;
+    using JobHeap = std::vector<Job, SizeClassAllocator<Job>>; // Keeps its capacity, so a queue that has grown once no longer allocates.
+
+    struct JobQueue
+    {
+        JobHeap m_Queue; // Binary heap with the most urgent job at the front.
+        uint64_t m_NextQueueSequence = 0;
+        std::mutex m_QueueLock;
+        uint32_t m_Capacity = 0; // Zero for unbounded. Only enforced by TryPushBack().
+
+        static bool IsLessUrgent(const Job& a, const Job& b)
         {
-            JobArguments jobArguments = {};
-            jobArguments.m_GroupID = m_GroupID;
-            if (m_SharedMemorySize > 0)
+            if (a.m_SchedulingKey != b.m_SchedulingKey)
             {
-                thread_local static std::vector<uint8_t> sharedAllocationData;
-                sharedAllocationData.reserve(m_SharedMemorySize);
-                jobArguments.m_SharedMemory = sharedAllocationData.data();
+                return a.m_SchedulingKey > b.m_SchedulingKey;
             }
-            else
+            return a.m_QueueSequence > b.m_QueueSequence;
+        }
+
+        // Orders the queue by scheduling key, so the front is always the earliest deadline. Equal keys remain FIFO. Logarithmic in the number of queued jobs.
+        void Insert(Job&& newJob)
+        {
+            newJob.m_QueueSequence = m_NextQueueSequence++;
+            m_Queue.push_back(std::move(newJob));
+            std::push_heap(m_Queue.begin(), m_Queue.end(), IsLessUrgent);
+        }
+
+        void PushBack(Job&& newJob)
+        {
+            std::scoped_lock lock(m_QueueLock);
+            Insert(std::move(newJob));
+        }
+
+        // Takes as many of the jobs as the capacity allows under a single lock. Returns how many were taken.
+        uint32_t TryPushBatch(Job* newJobs, uint32_t jobCount)
+        {
+            std::scoped_lock lock(m_QueueLock);
+            if (m_Capacity != 0)
             {
-                jobArguments.m_SharedMemory = nullptr;
+                jobCount = m_Queue.size() >= m_Capacity ? 0 : std::min(jobCount, m_Capacity - (uint32_t)m_Queue.size());
             }
 
-            for (uint32_t i = m_GroupJobOffset; i < m_GroupJobEnd; i++)
+            for (uint32_t i = 0; i < jobCount; i++)
             {
-                jobArguments.m_JobIndex = i;
-                jobArguments.m_JobGroupIndex = i - m_GroupJobOffset;
-                jobArguments.m_IsFirstJobInGroup = (i == m_GroupJobOffset);
-                jobArguments.m_IsLastJobInGroup = (i == (m_GroupJobEnd - 1));
-                m_Task(jobArguments);
+                Insert(std::move(newJobs[i]));
             }
-
-            m_Context->m_JobCounter.fetch_sub(1); // Decrement job count.
+            return jobCount;
         }
-    };
-
-    struct JobQueue
-    {
-        std::deque<Job> m_Queue;
-        std::mutex m_QueueLock;
 
-        void PushBack(const Job& newJob)
+        // The job is only moved from if it was taken.
+        bool TryPushBack(Job&& newJob)
         {
             std::scoped_lock lock(m_QueueLock);
-            m_Queue.push_back(newJob);
+            if (m_Capacity != 0 && m_Queue.size() >= m_Capacity)
+            {
+                return false;
+            }
+            Insert(std::move(newJob));
+            return true;
         }
 
         bool PopFront(Job& existingJob)
@@ -66,299 +108,2643 @@ namespace Cyclone
             {
                 return false;
             }
-            existingJob = std::move(m_Queue.front());
-            m_Queue.pop_front();
+            std::pop_heap(m_Queue.begin(), m_Queue.end(), IsLessUrgent);
+            existingJob = std::move(m_Queue.back());
+            m_Queue.pop_back();
             return true;
         }
-    };
-
-    struct PriorityResources
-    {
-        uint32_t m_ThreadCount = 0;
-        std::vector<std::thread> m_Threads;
-        std::unique_ptr<JobQueue[]> m_JobQueuesPerThread;
-        std::atomic<uint32_t> m_NextQueueIndex = 0;
-        std::condition_variable m_WakeCondition;
-        std::mutex m_WakeMutex;
 
-        // Starts working on a job queue. After the job queue is finished, it can switch to another queue and steal jobs from there.
-        void Work(uint32_t startingQueueIndex)
+        // Pops the most urgent job belonging to the given context, skipping over jobs of other contexts. Linear in the number of queued jobs,
+        // which is fine for the waiters of priority inheritance using it.
+        bool PopContext(const Context* executionContext, Job& existingJob)
         {
-            Job existingJob;
-            for (uint32_t i = 0; i < m_ThreadCount; i++)
+            std::scoped_lock lock(m_QueueLock);
+            auto mostUrgent = m_Queue.end();
+            for (auto it = m_Queue.begin(); it != m_Queue.end(); it++)
             {
-                JobQueue& jobQueue = m_JobQueuesPerThread[startingQueueIndex % m_ThreadCount];
-                while (jobQueue.PopFront(existingJob))
+                if (it->m_Context == executionContext && (mostUrgent == m_Queue.end() || IsLessUrgent(*mostUrgent, *it)))
                 {
-                    existingJob.Execute();
+                    mostUrgent = it;
                 }
+            }
 
-                startingQueueIndex++; // Head to the next queue and steal jobs.
+            if (mostUrgent == m_Queue.end())
+            {
+                return false;
             }
+            existingJob = std::move(*mostUrgent);
+            *mostUrgent = std::move(m_Queue.back());
+            m_Queue.pop_back();
+            std::make_heap(m_Queue.begin(), m_Queue.end(), IsLessUrgent);
+            return true;
         }
     };
 
-    // Once destroyed, worker threads will be woken up and end their loops.
-    struct InternalState
+    // Unbounded lock-free multiple producer, single consumer queue. Producers never block, but there must only ever be one consumer at a time.
+    // The most recently popped node is kept as the head sentinel, starting with the embedded stub.
+    template<typename T>
+    struct MPSCQueue
     {
-        uint32_t m_CoreCount = 0;
-        PriorityResources m_Resources[int(Priority::Count)];
-        std::atomic_bool m_IsAlive = true; // Denotes if new jobs can be addded to the scheduler.
+        struct Node
+        {
+            std::atomic<Node*> m_Next = nullptr;
+            T m_Value = {};
+        };
 
-        void Shutdown()
+        Node m_Stub;
+        Node* m_Head = &m_Stub;
+        std::atomic<Node*> m_Tail = &m_Stub;
+
+        ~MPSCQueue()
         {
-            m_IsAlive.store(false); // New jobs cannot be added from this point.
-            bool runWakingLoop = true;
-            std::thread wakingThread([&]
+            T value;
+            while (TryPop(value))
             {
-                while (runWakingLoop)
-                {
-                    for (auto& resource : m_Resources)
-                    {
-                        resource.m_WakeCondition.notify_all(); // Wakes up all sleeping worker threads.
-                    }
-                }
-            });
+            }
 
-            for (auto& resource : m_Resources)
+            if (m_Head != &m_Stub)
             {
-                for (auto& thread : resource.m_Threads)
-                {
-                    thread.join();
-                }
+                DeleteNode(m_Head);
             }
+        }
 
-            runWakingLoop = false;
-            wakingThread.join();
+        void Push(T value)
+        {
+            Node* newNode = new (SizeClassAlloc(sizeof(Node))) Node();
+            newNode->m_Value = std::move(value);
+            Node* previousNode = m_Tail.exchange(newNode, std::memory_order_acq_rel);
+            previousNode->m_Next.store(newNode, std::memory_order_release); // Until this is stored, the consumer sees the queue as empty.
+        }
 
-            for (auto& resource : m_Resources)
+        // Only meaningful to the consumer. A value midway through being pushed is not seen.
+        bool IsEmpty() const
+        {
+            return m_Head->m_Next.load(std::memory_order_acquire) == nullptr;
+        }
+
+        // Fails if the queue is empty, or if a producer is midway through pushing the next value.
+        bool TryPop(T& value)
+        {
+            Node* headNode = m_Head;
+            Node* nextNode = headNode->m_Next.load(std::memory_order_acquire);
+            if (nextNode == nullptr)
             {
-                resource.m_JobQueuesPerThread.reset();
-                resource.m_Threads.clear();
-                resource.m_ThreadCount = 0;
+                return false;
             }
 
-            m_CoreCount = 0;
+            value = std::move(nextNode->m_Value);
+            m_Head = nextNode;
+            if (headNode != &m_Stub)
+            {
+                DeleteNode(headNode);
+            }
+            return true;
         }
 
-        ~InternalState()
+        // Nodes are typically pushed by one thread and freed by another, which the size class caches handle without taking a lock.
+        static void DeleteNode(Node* node)
         {
-            Shutdown();
+            node->~Node();
+            SizeClassFree(node, sizeof(Node));
         }
     };
 
-    InternalState* g_InternalState = nullptr;
-
-    void Initialize(uint32_t maxThreadCount)
+    // Bounded lock-free multiple producer, multiple consumer queue. Every cell carries a sequence number telling producers and consumers whose turn it is,
+    // so neither side ever waits on the other. A producer only retries when racing another producer for the same cell, and fails instead of blocking when full.
+    template<typename T>
+    struct MPMCQueue
     {
-        g_InternalState = new InternalState();
-        maxThreadCount = std::max(1u, maxThreadCount); // 1 for our main thread.
-        g_InternalState->m_CoreCount = std::thread::hardware_concurrency();
+        struct Cell
+        {
+            std::atomic<size_t> m_Sequence = 0;
+            T m_Value = {};
+        };
 
-        for (int priorityTypeIndex = 0; priorityTypeIndex < int(Priority::Count); priorityTypeIndex++)
+        std::unique_ptr<Cell[]> m_Cells;
+        size_t m_CellMask = 0;
+        alignas(64) std::atomic<size_t> m_EnqueuePosition = 0; // Kept on their own cache lines, as producers and consumers hammer them independently.
+        alignas(64) std::atomic<size_t> m_DequeuePosition = 0;
+
+        // Capacity must be a power of two.
+        void Reset(size_t capacity)
         {
-            const Priority priorityType = (Priority)priorityTypeIndex;
-            PriorityResources& resource = g_InternalState->m_Resources[priorityTypeIndex];
-
-            // Calculate the actual number of worker threads we want. We want all threads to be assigned a core accordingly.
-            switch (priorityType)
-            {
-            case Priority::High:
-                resource.m_ThreadCount = g_InternalState->m_CoreCount - 1; // -1 for the main thread.
-                break;
-            case Priority::Low:
-                resource.m_ThreadCount = g_InternalState->m_CoreCount - 2; // -1 for the main thread, -1 for streaming.
-                break;
-            case Priority::Streaming:
-                resource.m_ThreadCount = 1;
-                break;
-            default:
-                assert(0);
-                break;
-            }
-
-            resource.m_ThreadCount = std::clamp(resource.m_ThreadCount, 1u, maxThreadCount);
-            resource.m_JobQueuesPerThread.reset(new JobQueue[resource.m_ThreadCount]);
-            resource.m_Threads.reserve(resource.m_ThreadCount);
+            assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+            m_Cells.reset(new Cell[capacity]);
+            m_CellMask = capacity - 1;
+            for (size_t i = 0; i < capacity; i++)
+            {
+                m_Cells[i].m_Sequence.store(i, std::memory_order_relaxed);
+            }
+            m_EnqueuePosition.store(0, std::memory_order_relaxed);
+            m_DequeuePosition.store(0, std::memory_order_relaxed);
+        }
 
-            for (uint32_t threadID = 0; threadID < resource.m_ThreadCount; threadID++)
+        // The value is only moved from if it was taken.
+        bool TryPush(T&& value)
+        {
+            size_t position = m_EnqueuePosition.load(std::memory_order_relaxed);
+            while (true)
             {
-                std::thread& workerThread = resource.m_Threads.emplace_back([threadID, &resource]
+                Cell& cell = m_Cells[position & m_CellMask];
+                const size_t sequence = cell.m_Sequence.load(std::memory_order_acquire);
+                const intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+                if (difference == 0)
                 {
-                    while (g_InternalState->m_IsAlive.load())
+                    if (m_EnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
                     {
-                        resource.Work(threadID);
-
-                        // Once jobs are complete, the thread is put to sleep until it is woken up again.
-                        std::unique_lock<std::mutex> lock(resource.m_WakeMutex);
-                        resource.m_WakeCondition.wait(lock);
+                        cell.m_Value = std::move(value);
+                        cell.m_Sequence.store(position + 1, std::memory_order_release);
+                        return true;
                     }
-                });
-
-                std::thread::native_handle_type threadHandle = workerThread.native_handle();
-                int coreID = threadID + 1;
-
-                if (priorityType == Priority::Streaming)
+                }
+                else if (difference < 0)
                 {
-                    // Put streaming on the last core.
-                    // The second thread with ID 1 with streaming prioprity is assigned to the second last core at N - 1 - 1.
-                    coreID = g_InternalState->m_CoreCount - 1 - threadID; 
+                    return false; // The cell still holds a value from the previous lap. Full.
                 }
-
-#ifdef _WIN32
-                // Put each thread on a dedicated core.
-                DWORD_PTR affinityMask = 1ull << coreID;
-                DWORD_PTR affinityResult = SetThreadAffinityMask(threadHandle, affinityMask);
-                assert(affinityResult > 0);
-
-                if (priorityType == Priority::High)
+                else
                 {
-                    BOOL priorityResult = SetThreadPriority(threadHandle, THREAD_PRIORITY_NORMAL);
-                    assert(priorityResult != 0);
+                    position = m_EnqueuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
 
-                    std::wstring threadName = L"Cyclone::HighPriorityJobThread_" + std::to_wstring(threadID);
-                    HRESULT namingResult = SetThreadDescription(threadHandle, threadName.c_str());
-                    assert(SUCCEEDED(namingResult));
+        bool TryPop(T& value)
+        {
+            size_t position = m_DequeuePosition.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell& cell = m_Cells[position & m_CellMask];
+                const size_t sequence = cell.m_Sequence.load(std::memory_order_acquire);
+                const intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+                if (difference == 0)
+                {
+                    if (m_DequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        value = std::move(cell.m_Value);
+                        cell.m_Value = {};
+                        cell.m_Sequence.store(position + m_CellMask + 1, std::memory_order_release);
+                        return true;
+                    }
                 }
-                else if (priorityType == Priority::Low)
+                else if (difference < 0)
                 {
-                    BOOL priorityResult = SetThreadPriority(threadHandle, THREAD_PRIORITY_LOWEST);
-                    assert(priorityResult != 0);
-
-                    std::wstring threadName = L"Cyclone::LowPriorityJobThread_" + std::to_wstring(threadID);
-                    HRESULT namingResult = SetThreadDescription(threadHandle, threadName.c_str());
-                    assert(SUCCEEDED(namingResult));
+                    return false; // Empty.
                 }
-                else if (priorityType == Priority::Streaming)
+                else
                 {
-                    BOOL priorityResult = SetThreadPriority(threadHandle, THREAD_PRIORITY_LOWEST);
-                    assert(priorityResult != 0);
-
-                    std::wstring threadName = L"Cyclone::StreamingLowPriorityJobThread_" + std::to_wstring(threadID);
-                    HRESULT namingResult = SetThreadDescription(threadHandle, threadName.c_str());
-                    assert(SUCCEEDED(namingResult));
+                    position = m_DequeuePosition.load(std::memory_order_relaxed);
                 }
-#endif               
             }
         }
+    };
 
-        // Post message to logging system.
-        char logMessage[256] = {};
-        snprintf(logMessage, sizeof(logMessage), "Cyclone initialized with %d Cores!\nHigh Priority Threads: %d\nLow Priority Threads: %d\nStreaming Threads: %d", g_InternalState->m_CoreCount, GetThreadCount(Priority::High), GetThreadCount(Priority::Low), GetThreadCount(Priority::Streaming));
-        std::cout << logMessage << "\n\n";
-    }
-
-    void Shutdown()
+    struct StrandQueue : MPSCQueue<std::function<void(JobArguments)>>
     {
-        g_InternalState->Shutdown();
-        delete g_InternalState;
-    }
+    };
 
-    uint32_t GetThreadCount(Priority priorityType)
+    struct HeldJobs
     {
-        return g_InternalState->m_Resources[int(priorityType)].m_ThreadCount;
-    }
+        JobDeque m_Jobs;
+        std::mutex m_Lock;
+    };
 
-    bool IsBusy(const Context& executionContext)
+    // Jobs pinned to a single thread with ExecuteOn(). Only its owner pops from it.
+    struct Mailbox : MPSCQueue<Job>
     {
-        return executionContext.m_JobCounter.load() > 0; // m_JobCounter denotes the number of jobs that still needs to be executed.
-    }
+    };
 
-    void Wait(const Context& executionContext)
+    struct PriorityResources;
+
+    // A single queued job carrying the payloads of several Execute() calls. Payloads may be appended until a worker picks the job up and seals it.
+    struct CoalescedBatch
     {
-        if (IsBusy(executionContext))
+        static constexpr uint32_t MaxPayloadCount = 16;
+        static constexpr uint32_t SealedBit = 1u << 31;
+
+        Context* m_Context = nullptr;
+        PriorityResources* m_Resource = nullptr;
+        const std::type_info* m_CallableType = nullptr;
+        std::shared_ptr<CoalescedBatch> m_Self; // Held on behalf of the queued job, which only captures a pointer so its task fits std::function without allocating.
+
+        std::atomic<uint32_t> m_State = 0; // Number of claimed payload slots, with SealedBit set once execution started.
+        std::atomic<bool> m_IsPublished[MaxPayloadCount] = {}; // A slot can be claimed a moment before its payload is written.
+        std::function<void(JobArguments)> m_Payloads[MaxPayloadCount];
+
+        // Only moved from if appended.
+        bool TryAppend(std::function<void(JobArguments)>&& task)
         {
-            PriorityResources& resource = g_InternalState->m_Resources[int(executionContext.m_Priority)];
+            uint32_t state = m_State.load();
+            do
+            {
+                if ((state & SealedBit) != 0 || state == MaxPayloadCount)
+                {
+                    return false;
+                }
+            } while (!m_State.compare_exchange_weak(state, state + 1));
 
-            // Wake any threads that might be sleeping.
-            resource.m_WakeCondition.notify_all();
+            m_Payloads[state] = std::move(task);
+            m_IsPublished[state].store(true, std::memory_order_release);
+            return true;
+        }
 
-            // Work() will pick up any jobs that are still waiting and execute them on this thread.
-            resource.Work(resource.m_NextQueueIndex.fetch_add(1) % resource.m_ThreadCount);
+        // Stops further payloads from being appended. Returns how many there are.
+        uint32_t Seal()
+        {
+            return m_State.fetch_or(SealedBit) & ~SealedBit;
+        }
 
-            while (IsBusy(executionContext))
+        void Execute(uint32_t payloadCount, JobArguments jobArguments)
+        {
+            for (uint32_t i = 0; i < payloadCount; i++)
             {
-                // If we're here, it means there are jobs that couldn't be picked up by this thread.
-                // In this case, it means there are jobs that are in the process of executing.
-                // We will allow the thread to be swapped out by the OS to avoid spinning endlessly.
-                std::this_thread::yield();
+                while (!m_IsPublished[i].load(std::memory_order_acquire))
+                {
+                    std::this_thread::yield();
+                }
+                m_Payloads[i](jobArguments);
+                m_Payloads[i] = nullptr;
             }
         }
-    }
+    };
 
-    uint32_t GetDispatchGroupCount(uint32_t jobCount, uint32_t groupSize)
+    // The batch most recently started by this thread. Further Execute() calls may append to it, if they are of the same context and callable.
+    thread_local std::shared_ptr<CoalescedBatch> t_CoalescedBatch;
+
+    // Per worker bookkeeping, used to find and boost the threads running jobs that a higher priority thread is waiting on.
+    struct WorkerState
     {
-        // Calculates the amount of job groups to dispatch. We will overestimate here.
-        return (jobCount + groupSize - 1) / groupSize;
+        ThreadID m_ThreadID = InvalidThreadID;
+        std::thread::native_handle_type m_ThreadHandle = {};
+        std::atomic<const Context*> m_ExecutingContext = nullptr;
+        std::atomic<uint32_t> m_BoostCount = 0;
+    };
+
+    // Workers boosted by a waiter, indexed like PriorityResources::m_WorkerStates.
+    using BoostedWorkerList = std::vector<bool, SizeClassAllocator<bool>>;
+
+    // Identifies the calling thread. Threads not owned by Cyclone (such as the main thread) are treated as high priority.
+    thread_local Priority t_WorkerPriority = Priority::Count;
+    thread_local WorkerState* t_WorkerState = nullptr;
+    thread_local LinearArena t_SharedMemoryArena; // Group shared memory of the jobs executing on the thread, nested ones included.
+    thread_local ThreadID t_ThreadID = InvalidThreadID;
+    thread_local const struct InternalState* t_ThreadRegistration = nullptr; // The instance t_ThreadID was handed out by. IDs don't survive reinitialization.
+    thread_local struct InternalState* t_WorkerScheduler = nullptr;          // The scheduler owning the calling worker, if any.
+
+    static Priority GetCallerPriority()
+    {
+        return t_WorkerPriority == Priority::Count ? Priority::High : t_WorkerPriority;
     }
 
-    // Singular task in its own group.
-    void Execute(Context& executionContext, const std::function<void(JobArguments)>& task)
+    constexpr uint32_t AnyQueueIndex = ~0u; // Lets submissions pick the queue of the job. See PriorityResources::TryPlace().
+
+    struct PriorityResources;
+    static void SpawnWorker(PriorityResources& resource, uint32_t threadID); // Called with PriorityResources::m_SpawnLock held.
+    static void EnsureTimerKeeper(InternalState& state);
+
+    struct PriorityResources
     {
-        PriorityResources& resource = g_InternalState->m_Resources[int(executionContext.m_Priority)];
+        struct InternalState* m_State = nullptr; // The scheduler owning the pool.
+        Priority m_PriorityType = Priority::High;
+        uint32_t m_ThreadCount = 0;      // Workers making up the target concurrency of the pool.
+        uint32_t m_SpareThreadCount = 0; // Extra workers, activated while workers of the pool are inside a BlockingScope. They follow the regular ones.
+        std::unique_ptr<std::thread[]> m_Threads; // Spawned lazily. See EnsureStarted().
+        std::unique_ptr<WorkerState[]> m_WorkerStates;
+        std::atomic_bool m_IsStarted = false;
+        std::mutex m_SpawnLock;
+        std::unique_ptr<JobQueue[]> m_JobQueuesPerThread;
+        // Per queue, every queue ordered by how far away its worker is, nearest first. Row i starts with queue i itself. Rebuilt whenever the cores
+        // of the pool change. Replaced orders are kept until destruction, as workers may still be walking them.
+        std::vector<std::unique_ptr<uint32_t[]>> m_StealOrders;
+        std::atomic<const uint32_t*> m_StealOrder = nullptr;
+        MPMCQueue<Job> m_InjectionQueue; // Submissions from threads that aren't our workers, so they never contend with our workers over the per thread queue locks.
+        std::atomic<uint32_t> m_NextQueueIndex = 0;
+        std::condition_variable m_WakeCondition;
+        std::mutex m_WakeMutex;
+        std::atomic<uint32_t> m_IdleThreadCount = 0; // Workers asleep on the wake condition.
 
-        // Update execution context.
-        executionContext.m_JobCounter.fetch_add(1);
+        // Thread count controller. Workers with an index at or above the active count are parked on their own condition,
+        // so wake ups meant for active workers are never swallowed by a parked one.
+        std::atomic<uint32_t> m_ActiveThreadCount = 0;
+        std::atomic<uint64_t> m_CompletedJobCount = 0;
+        std::atomic<uint32_t> m_ThreadBudget = 0; // Upper bound on active workers, from the cores the process is currently granted. See InternalState::UpdateCPUBudget().
+        std::condition_variable m_ParkCondition;
+        TimerID m_ControllerTimerID = 0;
+        std::shared_ptr<struct ThreadCountController> m_Controller; // Also referenced by its timer, so it outlives samples still running after it was disabled.
+        std::atomic<uint32_t> m_BlockedThreadCount = 0; // Workers inside a BlockingScope, each compensated for by a spare worker.
 
-        Job newJob;
-        newJob.m_Context = &executionContext;
-        newJob.m_Task = task;
-        newJob.m_GroupID = 0;
-        newJob.m_GroupJobOffset = 0;
-        newJob.m_GroupJobEnd = 1;
-        newJob.m_SharedMemorySize = 0;
+        // Real-time mode. See Scheduler::EnableRealTimeMode().
+        std::atomic<Duration::rep> m_PollTime = 0;      // How long idle workers busy-poll for work per poll period. Zero if they sleep right away.
+        std::atomic<Duration::rep> m_PollSleepTime = 0; // How long they then sleep for the rest of the period.
+        std::atomic<int> m_FIFOPriority = 0;            // SCHED_FIFO priority workers are spawned with. Zero if they are scheduled as usual.
 
-        // If our job system hasn't been initialized, or if only a single thread exists, the job is executed immediately.
-        if (resource.m_ThreadCount <= 1)
+        uint32_t GetWorkerCapacity() const
         {
-            newJob.Execute();
+            return m_ThreadCount + m_SpareThreadCount;
         }
 
-        resource.m_JobQueuesPerThread[resource.m_NextQueueIndex.fetch_add(1) % resource.m_ThreadCount].PushBack(newJob);
-        resource.m_WakeCondition.notify_one(); // All threads in the resource wait on this wake condition. This guarantees one awaiting thread is woken up to handle the job.
-    }
+        uint32_t GetActiveThreadCount() const
+        {
+            return std::min(m_ActiveThreadCount.load(), m_ThreadBudget.load());
+        }
 
-    void Dispatch(Context& executionContext, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArguments)>& task, size_t sharedMemorySize)
-    {
-        if (jobCount == 0 || groupSize == 0)
+        // Regular workers are active up to the count set by the thread count controller, within the budget. Spares are active while compensating for blocked workers.
+        // Threads that aren't workers of this pool, such as waiters helping out, are always active.
+        bool IsWorkerActive(uint32_t threadID) const
         {
-            return;
+            if (threadID == InvalidThreadID)
+            {
+                return true;
+            }
+            return threadID < m_ThreadCount ? threadID < GetActiveThreadCount() : (threadID - m_ThreadCount) < m_BlockedThreadCount.load();
         }
 
-        PriorityResources& resource = g_InternalState->m_Resources[int(executionContext.m_Priority)];
-        // A job is generated per group. Tasks within the same group execute serially, using the aforementioned job.
-        const uint32_t groupCount = GetDispatchGroupCount(jobCount, groupSize);
+        // The regular workers are spawned on first use of the pool, rather than up front in Initialize().
+        void EnsureStarted()
+        {
+            if (m_IsStarted.load(std::memory_order_acquire))
+            {
+                return;
+            }
 
-        // Update execution context.
-        executionContext.m_JobCounter.fetch_add(groupCount);
+            {
+                std::scoped_lock lock(m_SpawnLock);
+                for (uint32_t threadID = 0; threadID < m_ThreadCount; threadID++)
+                {
+                    if (!m_Threads[threadID].joinable())
+                    {
+                        SpawnWorker(*this, threadID);
+                    }
+                }
+                m_IsStarted.store(true, std::memory_order_release);
+            }
+            EnsureTimerKeeper(*m_State); // Internal timers, such as the CPU budget recheck, wait for the first job rather than starting the keeper themselves.
+        }
 
-        Job newJob;
-        newJob.m_Context = &executionContext;
-        newJob.m_Task = task;
-        newJob.m_SharedMemorySize = (uint32_t)sharedMemorySize;
+        void EnsureSpawned(uint32_t threadID)
+        {
+            std::scoped_lock lock(m_SpawnLock);
+            if (!m_Threads[threadID].joinable())
+            {
+                SpawnWorker(*this, threadID);
+            }
+        }
 
-        for (uint32_t groupID = 0; groupID < groupCount; groupID++)
+        // Backpressure. Every queued job is counted, whether or not it was submitted under the limits.
+        std::atomic<uint32_t> m_QueuedJobCount = 0;
+        std::atomic<uint32_t> m_TotalCapacity = 0; // Zero for unbounded.
+        std::atomic<BackpressurePolicy> m_BackpressurePolicy = BackpressurePolicy::Help;
+
+        // Queues a job regardless of any limits. Used for jobs that are already admitted, such as requeued ones.
+        void PushBack(Job&& newJob)
         {
-            // For each group, generate one real job.
-            newJob.m_GroupID = groupID;
-            newJob.m_GroupJobOffset = groupID * groupSize;
-            newJob.m_GroupJobEnd = std::min(newJob.m_GroupJobOffset + groupSize, jobCount); // Prevents overflowing at the lasr group.
+            EnsureStarted();
+            m_QueuedJobCount.fetch_add(1);
+            m_JobQueuesPerThread[m_NextQueueIndex.fetch_add(1) % m_ThreadCount].PushBack(std::move(newJob));
+            m_WakeCondition.notify_one(); // All threads in the resource wait on this wake condition. This guarantees one awaiting thread is woken up to handle the job.
+        }
+
+        // Claims room for the given number of jobs against the total capacity.
+        bool TryReserve(uint32_t jobCount)
+        {
+            EnsureStarted();
+            return TryReserveStarted(jobCount);
+        }
 
-            // If our job system hasn't been initialized, or if only a single thread exists, the job is executed immediately.
-            if (resource.m_ThreadCount <= 1)
+        // As above, for callers that must not spawn workers. Expects the pool to have been started already.
+        bool TryReserveStarted(uint32_t jobCount)
+        {
+            const uint32_t totalCapacity = m_TotalCapacity.load();
+            if (totalCapacity == 0)
             {
-                newJob.Execute();
+                m_QueuedJobCount.fetch_add(jobCount);
+                return true;
             }
-            else
+
+            uint32_t queuedJobCount = m_QueuedJobCount.load();
+            while (queuedJobCount + jobCount <= totalCapacity)
             {
-                resource.m_JobQueuesPerThread[resource.m_NextQueueIndex.fetch_add(1) % resource.m_ThreadCount].PushBack(newJob);
+                if (m_QueuedJobCount.compare_exchange_weak(queuedJobCount, queuedJobCount + jobCount))
+                {
+                    return true;
+                }
             }
+            return false;
         }
 
-        // Get all awaiting threads to pick off at the new jobs.
-        if (resource.m_ThreadCount > 1)
+        // Places a job that was already reserved for into the next queue with room, starting from the preferred queue if there is one.
+        // The caller is responsible for waking a worker. Jobs are moved through the queues, so their tasks are never copied. The job is only moved from if placed.
+        bool TryPlace(Job&& newJob, uint32_t preferredQueueIndex = AnyQueueIndex)
         {
-            resource.m_WakeCondition.notify_all();
+            const uint32_t startingQueueIndex = preferredQueueIndex != AnyQueueIndex ? preferredQueueIndex : m_NextQueueIndex.fetch_add(1);
+            for (uint32_t i = 0; i < m_ThreadCount; i++)
+            {
+                if (m_JobQueuesPerThread[(startingQueueIndex + i) % m_ThreadCount].TryPushBack(std::move(newJob)))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Fail fast dispatches lock every per thread queue, in index order, while checking for room and placing their groups. No other submitter
+        // can take the room in between, so a dispatch is either placed whole or not at all.
+        void LockQueues()
+        {
+            for (uint32_t i = 0; i < m_ThreadCount; i++)
+            {
+                m_JobQueuesPerThread[i].m_QueueLock.lock();
+            }
+        }
+
+        void UnlockQueues()
+        {
+            for (uint32_t i = m_ThreadCount; i > 0; i--)
+            {
+                m_JobQueuesPerThread[i - 1].m_QueueLock.unlock();
+            }
+        }
+
+        // Number of jobs the per thread queues have room for. Requires the queues to be locked.
+        uint64_t GetLockedQueueRoom() const
+        {
+            uint64_t queueRoom = 0;
+            for (uint32_t i = 0; i < m_ThreadCount; i++)
+            {
+                const JobQueue& jobQueue = m_JobQueuesPerThread[i];
+                if (jobQueue.m_Capacity == 0)
+                {
+                    return ~0ull;
+                }
+                queueRoom += jobQueue.m_Queue.size() < jobQueue.m_Capacity ? jobQueue.m_Capacity - jobQueue.m_Queue.size() : 0;
+            }
+            return queueRoom;
         }
+
+        // As TryPlace(), with the queues already locked and known to have room.
+        void PlaceLocked(Job&& newJob, uint32_t preferredQueueIndex)
+        {
+            for (uint32_t i = 0; i < m_ThreadCount; i++)
+            {
+                JobQueue& jobQueue = m_JobQueuesPerThread[(preferredQueueIndex + i) % m_ThreadCount];
+                if (jobQueue.m_Capacity == 0 || jobQueue.m_Queue.size() < jobQueue.m_Capacity)
+                {
+                    jobQueue.Insert(std::move(newJob));
+                    return;
+                }
+            }
+            assert(0);
+        }
+
+        // The job is only moved from if it was queued.
+        bool TryPushBack(Job&& newJob, uint32_t preferredQueueIndex = AnyQueueIndex)
+        {
+            if (!TryReserve(1))
+            {
+                return false;
+            }
+
+            // Jobs with deadlines go straight to the per thread queues, which are ordered earliest deadline first. The injection queue is plain FIFO.
+            // Workers of other schedulers handing work over count as external too. Jobs meant for a specific queue skip it.
+            const bool isExternalSubmission = t_WorkerPriority != m_PriorityType || t_WorkerScheduler != m_State;
+            if (isExternalSubmission && newJob.m_Deadline == NoDeadline && preferredQueueIndex == AnyQueueIndex && m_InjectionQueue.TryPush(std::move(newJob)))
+            {
+                return true;
+            }
+
+            if (!TryPlace(std::move(newJob), preferredQueueIndex))
+            {
+                m_QueuedJobCount.fetch_sub(1);
+                return false;
+            }
+            return true;
+        }
+
+        // The pool is saturated when no worker is idle and the queues already hold several jobs per worker. A new job would then only wait in line,
+        // so it is cheaper for the submitter to execute it right away.
+        bool IsSaturated() const
+        {
+            constexpr uint32_t saturatedJobsPerThread = 4;
+            return m_IdleThreadCount.load(std::memory_order_relaxed) == 0 && m_QueuedJobCount.load(std::memory_order_relaxed) >= saturatedJobsPerThread * GetActiveThreadCount();
+        }
+
+        // Wakes as many workers as there are new jobs, up to all of them.
+        void Wake(uint32_t jobCount)
+        {
+            if (jobCount >= m_ThreadCount)
+            {
+                m_WakeCondition.notify_all();
+                return;
+            }
+
+            for (uint32_t i = 0; i < jobCount; i++)
+            {
+                m_WakeCondition.notify_one();
+            }
+        }
+
+        // Starts working on a job queue. After the job queue is finished, it can switch to another queue and steal jobs from there.
+        // Workers pass their own ID, so they stop as soon as they are parked or retired.
+        void Work(uint32_t startingQueueIndex, uint32_t workerThreadID = InvalidThreadID)
+        {
+            Job existingJob;
+            const uint32_t* stealOrder = m_StealOrder.load(std::memory_order_acquire) + (startingQueueIndex % m_ThreadCount) * m_ThreadCount;
+            for (uint32_t i = 0; i < m_ThreadCount; i++)
+            {
+                JobQueue& jobQueue = m_JobQueuesPerThread[stealOrder[i]];
+                while (IsWorkerActive(workerThreadID) && jobQueue.PopFront(existingJob))
+                {
+                    m_QueuedJobCount.fetch_sub(1);
+                    existingJob.Execute();
+                }
+
+                // Once our own queue is empty, external submissions are next in line before stealing from other workers.
+                if (i == 0)
+                {
+                    while (IsWorkerActive(workerThreadID) && m_InjectionQueue.TryPop(existingJob))
+                    {
+                        m_QueuedJobCount.fetch_sub(1);
+                        existingJob.Execute();
+                    }
+                }
+            }
+        }
+
+        // Executes a single queued job, if there is any. Used by submitters waiting for room in the queues.
+        bool ExecuteNext()
+        {
+            Job existingJob;
+            const uint32_t startingQueueIndex = m_NextQueueIndex.load();
+            for (uint32_t i = 0; i < m_ThreadCount; i++)
+            {
+                if (m_JobQueuesPerThread[(startingQueueIndex + i) % m_ThreadCount].PopFront(existingJob))
+                {
+                    m_QueuedJobCount.fetch_sub(1);
+                    existingJob.Execute();
+                    return true;
+                }
+            }
+
+            if (m_InjectionQueue.TryPop(existingJob))
+            {
+                m_QueuedJobCount.fetch_sub(1);
+                existingJob.Execute();
+                return true;
+            }
+            return false;
+        }
+
+        bool PopContext(const Context* executionContext, Job& existingJob)
+        {
+            for (uint32_t i = 0; i < m_ThreadCount; i++)
+            {
+                if (m_JobQueuesPerThread[i].PopContext(executionContext, existingJob))
+                {
+                    m_QueuedJobCount.fetch_sub(1);
+                    return true;
+                }
+            }
+
+            // The injection queue can't be searched in place, and moving the jobs of other contexts out of the way would break the submission order
+            // TryExecute() promises. Its jobs are left to the workers of the pool.
+            return false;
+        }
+
+        // Temporarily raises any of our workers currently executing jobs of the given context to the waiter's priority.
+        // Workers boosted by this call are flagged in boostedWorkers, so they can be restored once the wait is over.
+        void BoostWorkersExecuting(const Context* executionContext, Priority waiterPriority, BoostedWorkerList& boostedWorkers)
+        {
+            boostedWorkers.resize(GetWorkerCapacity(), false);
+            for (uint32_t i = 0; i < GetWorkerCapacity(); i++)
+            {
+                WorkerState& workerState = m_WorkerStates[i];
+                if (!boostedWorkers[i] && workerState.m_ExecutingContext.load() == executionContext)
+                {
+                    boostedWorkers[i] = true;
+                    if (workerState.m_BoostCount.fetch_add(1) == 0)
+                    {
+                        SetOSThreadPriority(workerState.m_ThreadHandle, waiterPriority);
+                    }
+                }
+            }
+        }
+
+        void RestoreBoostedWorkers(const BoostedWorkerList& boostedWorkers)
+        {
+            for (uint32_t i = 0; i < (uint32_t)boostedWorkers.size(); i++)
+            {
+                if (boostedWorkers[i] && m_WorkerStates[i].m_BoostCount.fetch_sub(1) == 1)
+                {
+                    SetOSThreadPriority(m_WorkerStates[i].m_ThreadHandle, m_PriorityType);
+                }
+            }
+        }
+    };
+
+    constexpr size_t FrameArenaBlockSize = 1024 * 1024;
+
+    // Bytes handed out by the frame arena of a thread, in requested sizes. Written by the owning thread only, and read by GetFrameArenaStatistics().
+    struct FrameArenaUsage
+    {
+        ThreadID m_ThreadID = InvalidThreadID;
+        std::atomic<size_t> m_UsedSize = 0;
+        std::atomic<size_t> m_PeakSize = 0;
+    };
+
+    // Linear arena of a thread for FrameAlloc(). Rewound lazily, by the first allocation of a new frame, so threads sitting idle across frames cost nothing.
+    struct FrameArena
+    {
+        LinearArena m_Arena = LinearArena(FrameArenaBlockSize);
+        uint64_t m_SchedulerID = 0;
+        uint64_t m_FrameIndex = 0;
+        std::shared_ptr<FrameArenaUsage> m_Usage; // Shared with the scheduler, so usage can be reported while the thread runs.
+    };
+
+    std::atomic<uint64_t> g_NextSchedulerID = 1;
+    thread_local FrameArena t_FrameArena;
+
+    // A context being waited on by a thread of higher priority than the context itself.
+    struct InheritedContext
+    {
+        const Context* m_Context = nullptr;
+        Priority m_ContextPriority = Priority::High;
+        Priority m_WaiterPriority = Priority::High;
+    };
+
+    // Workers take a copy of the list each time they look for inherited work, so it allocates from the size class caches. See SizeClassAlloc().
+    using InheritedContextList = std::vector<InheritedContext, SizeClassAllocator<InheritedContext>>;
+
+    // Once destroyed, worker threads will be woken up and end their loops.
+    struct InternalState
+    {
+        uint32_t m_CoreCount = 0;      // Cores granted when the scheduler was created, which the pools are sized after.
+        std::vector<uint32_t> m_Cores; // Cores the workers may be placed on, in topology order. Guarded by m_CoreLock once workers exist.
+        std::vector<uint32_t> m_PoolCores[int(Priority::Count)]; // Cores of each pool, in order of preference. See AssignCores().
+        std::vector<uint32_t> m_RealTimeCores; // Isolated cores taking the place of the high priority pool cores while in real-time mode.
+        std::mutex m_RealTimeLock;
+        bool m_IsMemoryLocked = false;
+        std::mutex m_CoreLock;
+        Topology m_Topology;
+        std::vector<uint32_t> m_RequestedCores; // As given to the constructor. Empty for any core.
+        CorePlacement m_CorePlacement = CorePlacement::PhysicalCores;
+        TimerID m_CPUBudgetTimerID = 0;
+        Context m_CPUBudgetContext; // Rechecks of the CPU budget read cgroup and sysfs files, so they run on the streaming pool.
+
+        // Job slots shared with make and the other tools it runs. See Scheduler::EnableJobServer().
+        JobServer m_JobServer;
+        std::mutex m_JobServerLock;
+        std::atomic_bool m_IsJobServerEnabled = false;
+        PriorityResources m_Resources[int(Priority::Count)];
+        std::atomic_bool m_IsAlive = true; // Denotes if new jobs can be addded to the scheduler.
+
+        // Deadline scheduling.
+        std::atomic<Duration::rep> m_AgingWindow = std::chrono::duration_cast<Duration>(std::chrono::milliseconds(100)).count();
+        std::atomic<TimePoint::rep> m_FrameDeadline = NoDeadline.time_since_epoch().count();
+        std::atomic<uint32_t> m_FrameDeadlineJobCount = 0;
+        std::atomic<uint32_t> m_FrameDeadlineMissCount = 0;
+        std::atomic<Duration::rep> m_FrameWorstLateness = 0;
+
+        // Frame allocation. Arenas of threads compare the frame index against the one they were last rewound in. See FrameAlloc().
+        const uint64_t m_SchedulerID = g_NextSchedulerID.fetch_add(1); // Unlike the address of the instance, never reused.
+        std::atomic<uint64_t> m_FrameIndex = 0;
+        std::mutex m_FrameArenaLock;
+        std::vector<std::shared_ptr<FrameArenaUsage>> m_FrameArenaUsages;
+
+        std::atomic_bool m_IsCoalescingEnabled = true;
+
+        // Priority inheritance. Contexts listed here have their queued jobs stolen by workers of the waiter's priority.
+        InheritedContextList m_InheritedContexts;
+        std::mutex m_InheritanceLock;
+        std::atomic<uint32_t> m_InheritedContextCount = 0;
+
+        // Delayed and periodic jobs. Serviced by workers in between jobs, with the first high priority worker sleeping no longer than the next expiry.
+        TimerWheel m_TimerWheel;
+        Context m_TimerContext; // Context of periodic jobs submitted without one.
+
+        // Mailboxes of workers and registered threads, indexed by their ThreadID. Once full, the table is replaced by a larger copy. Replaced tables are kept
+        // until destruction, as other threads may still be reading them, so looking up a mailbox never takes a lock.
+        struct MailboxTable
+        {
+            std::unique_ptr<Mailbox*[]> m_Mailboxes;
+            uint32_t m_Capacity = 0;
+        };
+        std::mutex m_MailboxLock;
+        std::vector<std::unique_ptr<Mailbox>> m_MailboxStorage;
+        std::vector<std::unique_ptr<MailboxTable>> m_MailboxTables; // The last one is current.
+        std::atomic<MailboxTable*> m_MailboxTable = nullptr;
+        std::atomic<uint32_t> m_RegisteredThreadCount = 0;
+
+        // Requested cores that the process is allowed on, one per physical core unless placing on logical cores. Cores come sorted by topology,
+        // so the first SMT sibling allowed represents its physical core.
+        std::vector<uint32_t> SelectCores(const std::vector<uint32_t>& allowedCores) const
+        {
+            std::vector<uint32_t> cores;
+            uint32_t previousPhysicalCoreID = ~0u;
+            for (const Topology::LogicalCore& logicalCore : m_Topology.m_LogicalCores)
+            {
+                const bool isRequested = m_RequestedCores.empty() || std::find(m_RequestedCores.begin(), m_RequestedCores.end(), logicalCore.m_Core) != m_RequestedCores.end();
+                const bool isAllowed = allowedCores.empty() || std::find(allowedCores.begin(), allowedCores.end(), logicalCore.m_Core) != allowedCores.end();
+                if (!isRequested || !isAllowed || (m_CorePlacement == CorePlacement::PhysicalCores && logicalCore.m_PhysicalCoreID == previousPhysicalCoreID))
+                {
+                    continue;
+                }
+
+                cores.push_back(logicalCore.m_Core);
+                previousPhysicalCoreID = logicalCore.m_PhysicalCoreID;
+            }
+            return cores;
+        }
+
+        // High priority workers take the cores after the first, left to the main thread, while streaming takes the last. On hybrid CPUs, frame
+        // critical work is kept to performance cores, whereas low priority and streaming work goes to efficiency cores first. The main thread
+        // still keeps the first performance core and streaming the last efficiency core, leaving low priority workers the rest as before.
+        void AssignCores(const std::vector<uint32_t>& cores)
+        {
+            std::vector<uint32_t> performanceCores;
+            std::vector<uint32_t> efficiencyCores;
+            for (uint32_t core : cores)
+            {
+                (m_Topology.IsEfficiencyCore(core) ? efficiencyCores : performanceCores).push_back(core);
+            }
+
+            m_Cores = cores;
+            if (performanceCores.empty() || efficiencyCores.empty())
+            {
+                for (std::vector<uint32_t>& poolCores : m_PoolCores)
+                {
+                    poolCores = cores;
+                }
+                return;
+            }
+
+            std::vector<uint32_t>& lowPriorityCores = m_PoolCores[int(Priority::Low)];
+            lowPriorityCores.assign(1, performanceCores.front());
+            lowPriorityCores.insert(lowPriorityCores.end(), efficiencyCores.begin(), efficiencyCores.end() - 1);
+            lowPriorityCores.insert(lowPriorityCores.end(), performanceCores.begin() + 1, performanceCores.end());
+            lowPriorityCores.push_back(efficiencyCores.back());
+            m_PoolCores[int(Priority::High)] = std::move(performanceCores);
+            m_PoolCores[int(Priority::Streaming)] = std::move(efficiencyCores);
+        }
+
+        ThreadID CreateMailbox()
+        {
+            std::scoped_lock lock(m_MailboxLock);
+            const ThreadID threadID = (ThreadID)m_MailboxStorage.size();
+            MailboxTable* mailboxTable = m_MailboxTable.load(std::memory_order_relaxed);
+            if (mailboxTable == nullptr || threadID == mailboxTable->m_Capacity)
+            {
+                std::unique_ptr<MailboxTable> newTable = std::make_unique<MailboxTable>();
+                newTable->m_Capacity = std::max(64u, threadID * 2);
+                newTable->m_Mailboxes.reset(new Mailbox*[newTable->m_Capacity]());
+                for (ThreadID i = 0; i < threadID; i++)
+                {
+                    newTable->m_Mailboxes[i] = mailboxTable->m_Mailboxes[i];
+                }
+                mailboxTable = newTable.get();
+                m_MailboxTables.push_back(std::move(newTable));
+                m_MailboxTable.store(mailboxTable, std::memory_order_release);
+            }
+
+            m_MailboxStorage.push_back(std::make_unique<Mailbox>());
+            mailboxTable->m_Mailboxes[threadID] = m_MailboxStorage.back().get();
+            m_RegisteredThreadCount.store(threadID + 1, std::memory_order_release); // Published last, so a table holding the mailbox is visible by then.
+            return threadID;
+        }
+
+        // Null for IDs that weren't handed out by this instance, such as InvalidThreadID.
+        Mailbox* FindMailbox(ThreadID threadID) const
+        {
+            if (threadID >= m_RegisteredThreadCount.load(std::memory_order_acquire))
+            {
+                return nullptr;
+            }
+            return m_MailboxTable.load(std::memory_order_acquire)->m_Mailboxes[threadID];
+        }
+
+        ThreadID GetCurrentThreadID() const
+        {
+            return t_ThreadRegistration == this ? t_ThreadID : InvalidThreadID;
+        }
+
+        // Executes the jobs pinned to the calling thread, if it has a mailbox.
+        uint32_t RunPending()
+        {
+            const ThreadID threadID = GetCurrentThreadID();
+            if (threadID == InvalidThreadID)
+            {
+                return 0;
+            }
+
+            Mailbox& mailbox = *FindMailbox(threadID);
+            uint32_t executedJobCount = 0;
+            Job pinnedJob;
+            while (mailbox.TryPop(pinnedJob))
+            {
+                pinnedJob.Execute();
+                executedJobCount++;
+            }
+            return executedJobCount;
+        }
+
+        // Jobs with a deadline are ordered by it. Jobs without one are aged, becoming due a fixed window after their submission.
+        TimePoint GetSchedulingKey(TimePoint deadline, TimePoint submissionTime) const
+        {
+            return deadline != NoDeadline ? deadline : submissionTime + Duration(m_AgingWindow.load(std::memory_order_relaxed));
+        }
+
+        void RecordDeadline(TimePoint deadline, TimePoint completionTime, uint32_t jobCount = 1)
+        {
+            m_FrameDeadlineJobCount.fetch_add(jobCount, std::memory_order_relaxed);
+            if (completionTime <= deadline)
+            {
+                return;
+            }
+
+            m_FrameDeadlineMissCount.fetch_add(jobCount, std::memory_order_relaxed);
+            const Duration::rep lateness = (completionTime - deadline).count();
+            Duration::rep worstLateness = m_FrameWorstLateness.load(std::memory_order_relaxed);
+            while (lateness > worstLateness && !m_FrameWorstLateness.compare_exchange_weak(worstLateness, lateness, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        void BeginPriorityInheritance(const Context& executionContext, Priority waiterPriority)
+        {
+            {
+                std::scoped_lock lock(m_InheritanceLock);
+                m_InheritedContexts.push_back({ &executionContext, executionContext.m_Priority, waiterPriority });
+                m_InheritedContextCount.fetch_add(1);
+            }
+
+            // Let the waiter's workers pick up the awaited jobs. Its pool may not have been used yet, in which case there is nobody to wake.
+            m_Resources[int(waiterPriority)].EnsureStarted();
+            m_Resources[int(waiterPriority)].m_WakeCondition.notify_all();
+        }
+
+        void EndPriorityInheritance(const Context& executionContext)
+        {
+            std::scoped_lock lock(m_InheritanceLock);
+            auto it = std::find_if(m_InheritedContexts.begin(), m_InheritedContexts.end(), [&](const InheritedContext& inheritedContext) { return inheritedContext.m_Context == &executionContext; });
+            assert(it != m_InheritedContexts.end());
+            m_InheritedContexts.erase(it);
+            m_InheritedContextCount.fetch_sub(1);
+        }
+
+        // Called by workers once their own queues are empty. Executes queued jobs of lower priority contexts that a thread of our priority is waiting on.
+        void WorkInherited(Priority workerPriority)
+        {
+            InheritedContextList inheritedContexts;
+            while (m_InheritedContextCount.load() > 0)
+            {
+                {
+                    std::scoped_lock lock(m_InheritanceLock);
+                    inheritedContexts = m_InheritedContexts;
+                }
+
+                Job existingJob;
+                bool executedJob = false;
+                for (const InheritedContext& inheritedContext : inheritedContexts)
+                {
+                    if (int(inheritedContext.m_WaiterPriority) < int(workerPriority) || int(inheritedContext.m_ContextPriority) <= int(workerPriority))
+                    {
+                        continue;
+                    }
+
+                    while (m_Resources[int(inheritedContext.m_ContextPriority)].PopContext(inheritedContext.m_Context, existingJob))
+                    {
+                        existingJob.Execute();
+                        executedJob = true;
+                    }
+                }
+
+                if (!executedJob)
+                {
+                    return;
+                }
+            }
+        }
+
+        // Submits the jobs of any expired timers. Cheap enough to call whenever a thread is about to go idle.
+        void ServiceTimers()
+        {
+            const TimePoint currentTime = std::chrono::steady_clock::now();
+            if (currentTime < m_TimerWheel.GetNextExpiry())
+            {
+                return;
+            }
+
+            TimerWheel::CallbackList dueCallbacks;
+            if (m_TimerWheel.Service(currentTime, dueCallbacks))
+            {
+                for (const TimerWheel::Callback& dueCallback : dueCallbacks)
+                {
+                    dueCallback->Invoke();
+                }
+            }
+        }
+
+        // Timers of the user start the timer keeper. Internal ones leave that to the first job, so an unused scheduler doesn't spawn any threads.
+        TimerID ScheduleTimer(TimePoint expiry, Duration period, TimerWheel::Callback callback, bool isUserTimer = true)
+        {
+            const TimePoint previousExpiry = m_TimerWheel.GetNextExpiry();
+            const TimerID timerID = m_TimerWheel.Schedule(expiry, period, std::move(callback));
+            if (isUserTimer)
+            {
+                EnsureTimerKeeper(*this);
+            }
+
+            // The timer keeper may be asleep with a later wake up time. Let it pick up the new one.
+            if (m_TimerWheel.GetNextExpiry() < previousExpiry)
+            {
+                m_Resources[int(Priority::High)].m_WakeCondition.notify_all();
+            }
+            return timerID;
+        }
+
+        void Shutdown()
+        {
+            m_IsAlive.store(false); // New jobs cannot be added from this point.
+            std::atomic_bool runWakingLoop = true;
+            std::thread wakingThread([&]
+            {
+                while (runWakingLoop)
+                {
+                    for (auto& resource : m_Resources)
+                    {
+                        resource.m_WakeCondition.notify_all(); // Wakes up all sleeping worker threads.
+                        resource.m_ParkCondition.notify_all();
+                    }
+                }
+            });
+
+            for (auto& resource : m_Resources)
+            {
+                for (uint32_t threadID = 0; resource.m_Threads != nullptr && threadID < resource.GetWorkerCapacity(); threadID++)
+                {
+                    if (resource.m_Threads[threadID].joinable())
+                    {
+                        resource.m_Threads[threadID].join();
+                    }
+                }
+            }
+
+            runWakingLoop = false;
+            wakingThread.join();
+
+            for (auto& resource : m_Resources)
+            {
+                resource.m_JobQueuesPerThread.reset();
+                resource.m_WorkerStates.reset();
+                resource.m_Threads.reset();
+                resource.m_ThreadCount = 0;
+                resource.m_SpareThreadCount = 0;
+            }
+
+            m_CoreCount = 0;
+        }
+
+        ~InternalState()
+        {
+            Shutdown();
+        }
+    };
+
+    Scheduler* g_DefaultScheduler = nullptr;
+
+    // Contexts without a scheduler of their own run on the default one.
+    static InternalState& GetState(const Context& executionContext)
+    {
+        return *(executionContext.m_Scheduler != nullptr ? executionContext.m_Scheduler : g_DefaultScheduler)->m_State;
+    }
+
+    static void EnsureTimerKeeper(InternalState& state)
+    {
+        state.m_Resources[int(Priority::High)].EnsureSpawned(0);
+    }
+
+    constexpr size_t InjectionQueueCapacity = 1024; // Per priority. Submissions beyond this spill over into the per thread queues.
+    constexpr Duration CPUBudgetRecheckInterval = std::chrono::seconds(1);
+    constexpr Duration JobTokenWaitTime = std::chrono::milliseconds(10);
+    constexpr Duration TinyJobCost = std::chrono::microseconds(5); // Jobs hinted to take no longer than this cost less to execute in line than to queue.
+
+    static SubmitStatus SubmitTask(Context& executionContext, std::function<void(JobArguments)> task, TimePoint deadline, bool isUserSubmission);
+
+    static bool IsTinyJob(const Context& executionContext)
+    {
+        return executionContext.m_CostHint > Duration::zero() && executionContext.m_CostHint <= TinyJobCost;
+    }
+
+    static bool TryAcquireJobClass(JobClass& jobClass)
+    {
+        uint32_t runningCount = jobClass.m_RunningCount.load();
+        while (runningCount < jobClass.m_MaxConcurrency)
+        {
+            if (jobClass.m_RunningCount.compare_exchange_weak(runningCount, runningCount + 1))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Moves the oldest held job of the class back into the queues of its priority.
+    static void RequeueHeldJob(JobClass& jobClass)
+    {
+        std::scoped_lock lock(jobClass.m_HeldJobs->m_Lock);
+        JobDeque& heldJobs = jobClass.m_HeldJobs->m_Jobs;
+        if (heldJobs.empty())
+        {
+            return;
+        }
+
+        Job heldJob = std::move(heldJobs.front());
+        heldJobs.pop_front();
+        jobClass.m_HeldCount.fetch_sub(1);
+        GetState(*heldJob.m_Context).m_Resources[int(heldJob.m_Context->m_Priority)].PushBack(std::move(heldJob));
+    }
+
+    // Takes a slot of the class for the job, or else holds the job back and returns false. Once held, the job may be requeued, executed and its context
+    // waited on by others as soon as the lock is released, so neither the job nor the class may be touched afterwards.
+    // Holding publishes the held count before checking for a slot, and releasing frees its slot before checking the held count, so a held job can't be missed.
+    static bool AcquireOrHoldJobClass(JobClass& jobClass, Job& job)
+    {
+        if (TryAcquireJobClass(jobClass))
+        {
+            return true;
+        }
+
+        std::scoped_lock lock(jobClass.m_HeldJobs->m_Lock);
+        jobClass.m_HeldCount.fetch_add(1);
+        if (TryAcquireJobClass(jobClass))
+        {
+            jobClass.m_HeldCount.fetch_sub(1);
+            return true;
+        }
+        jobClass.m_HeldJobs->m_Jobs.push_back(std::move(job));
+        return false;
+    }
+
+    // Called before the job counts as complete, so its context, and with it the class, are still alive.
+    static void ReleaseJobClass(JobClass& jobClass)
+    {
+        jobClass.m_RunningCount.fetch_sub(1);
+        if (jobClass.m_HeldCount.load() > 0)
+        {
+            RequeueHeldJob(jobClass);
+        }
+    }
+
+    JobClass::JobClass(uint32_t maxConcurrency) : m_MaxConcurrency(std::max(1u, maxConcurrency)), m_HeldJobs(std::make_unique<HeldJobs>())
+    {
+    }
+
+    JobClass::~JobClass()
+    {
+        assert(m_HeldCount.load() == 0);
+    }
+
+    void Job::Execute()
+    {
+        // A class at its limit keeps the job for later, and the worker moves on.
+        if (m_JobClass != nullptr && !AcquireOrHoldJobClass(*m_JobClass, *this))
+        {
+            return;
+        }
+
+        JobArguments jobArguments = {};
+        jobArguments.m_GroupID = m_GroupID;
+
+        // Jobs waiting on others may execute further groups on this thread before their own group is done, so the memory of the group is released
+        // by rewinding rather than resetting the arena.
+        const LinearArena::Marker sharedMemoryMarker = t_SharedMemoryArena.GetMarker();
+        if (m_SharedMemorySize > 0)
+        {
+            jobArguments.m_SharedMemory = t_SharedMemoryArena.Allocate(m_SharedMemorySize, m_SharedMemoryAlignment);
+            jobArguments.m_SharedMemorySize = m_SharedMemorySize;
+            if (m_IsSharedMemoryZeroed)
+            {
+                memset(jobArguments.m_SharedMemory, 0, m_SharedMemorySize);
+            }
+        }
+
+        // Published so that waiters of higher priority can find and boost this thread.
+        const Context* previousContext = nullptr;
+        if (t_WorkerState != nullptr)
+        {
+            previousContext = t_WorkerState->m_ExecutingContext.exchange(m_Context);
+        }
+
+        for (uint32_t i = m_GroupJobOffset; i < m_GroupJobEnd; i++)
+        {
+            jobArguments.m_JobIndex = i;
+            jobArguments.m_JobGroupIndex = i - m_GroupJobOffset;
+            jobArguments.m_IsFirstJobInGroup = (i == m_GroupJobOffset);
+            jobArguments.m_IsLastJobInGroup = (i == (m_GroupJobEnd - 1));
+            m_Task(jobArguments);
+        }
+        t_SharedMemoryArena.Rewind(sharedMemoryMarker);
+
+        if (t_WorkerState != nullptr)
+        {
+            t_WorkerState->m_ExecutingContext.store(previousContext);
+        }
+
+        if (m_JobClass != nullptr)
+        {
+            ReleaseJobClass(*m_JobClass);
+        }
+
+        InternalState& state = GetState(*m_Context);
+        if (m_Deadline != NoDeadline)
+        {
+            state.RecordDeadline(m_Deadline, std::chrono::steady_clock::now());
+        }
+
+        state.m_Resources[int(m_Context->m_Priority)].m_CompletedJobCount.fetch_add(1, std::memory_order_relaxed);
+        m_Context->m_JobCounter.fetch_sub(1); // Decrement job count.
+    }
+
+    static uint32_t GetWorkerCore(const PriorityResources& resource, uint32_t threadID)
+    {
+        InternalState& state = *resource.m_State;
+        std::scoped_lock lock(state.m_CoreLock);
+        const std::vector<uint32_t>& cores = state.m_PoolCores[int(resource.m_PriorityType)];
+        const uint32_t coreCount = (uint32_t)cores.size();
+        const uint32_t coreThreadID = threadID % resource.m_ThreadCount; // Spares share the core of the worker they stand in for, which is blocked anyway.
+        if (resource.m_PriorityType == Priority::High && !state.m_RealTimeCores.empty())
+        {
+            return state.m_RealTimeCores[coreThreadID % state.m_RealTimeCores.size()];
+        }
+
+        uint32_t coreID = coreThreadID + 1;
+
+        if (resource.m_PriorityType == Priority::Streaming)
+        {
+            // Put streaming on the last core.
+            // The second thread with ID 1 with streaming prioprity is assigned to the second last core at N - 1 - 1.
+            coreID = coreCount - 1 - coreThreadID % coreCount; 
+        }
+        return cores[coreID % coreCount]; // Pools may outnumber the cores granted, in which case workers share them.
+    }
+
+    // Thieves try the queues of workers sharing their core first, then their L3, NUMA node and socket. Within each level, queues of workers on
+    // efficiency cores come first, as their backlog drains the slowest, followed by a rotation starting after the thief, so that thieves don't all
+    // pile onto the same victim.
+    static void BuildStealOrder(PriorityResources& resource)
+    {
+        const Topology& topology = resource.m_State->m_Topology;
+        const uint32_t queueCount = resource.m_ThreadCount;
+
+        // Cores are looked up once per worker, and distances once per pair of workers, so sorting only compares table entries.
+        std::vector<uint32_t> workerCores(queueCount);
+        std::vector<const Topology::LogicalCore*> workerLogicalCores(queueCount);
+        for (uint32_t i = 0; i < queueCount; i++)
+        {
+            workerCores[i] = GetWorkerCore(resource, i);
+            workerLogicalCores[i] = topology.Find(workerCores[i]);
+        }
+
+        std::vector<std::pair<Topology::Distance, bool>> stealRanks(queueCount * queueCount); // Of each victim for each thief. Lower is stolen from first.
+        for (uint32_t thief = 0; thief < queueCount; thief++)
+        {
+            for (uint32_t victim = 0; victim < queueCount; victim++)
+            {
+                const Topology::LogicalCore* thiefCore = workerLogicalCores[thief];
+                const Topology::LogicalCore* victimCore = workerLogicalCores[victim];
+                const Topology::Distance distance = thiefCore != nullptr && victimCore != nullptr ? Topology::GetDistance(*thiefCore, *victimCore)
+                                                                                                  : topology.GetDistance(workerCores[thief], workerCores[victim]);
+                stealRanks[thief * queueCount + victim] = { distance, victimCore == nullptr || !victimCore->m_IsEfficiencyCore };
+            }
+        }
+
+        std::unique_ptr<uint32_t[]> newStealOrder(new uint32_t[queueCount * queueCount]);
+        for (uint32_t thief = 0; thief < queueCount; thief++)
+        {
+            uint32_t* stealOrder = &newStealOrder[thief * queueCount];
+            for (uint32_t i = 0; i < queueCount; i++)
+            {
+                stealOrder[i] = (thief + i) % queueCount;
+            }
+
+            const std::pair<Topology::Distance, bool>* thiefRanks = &stealRanks[thief * queueCount];
+            std::stable_sort(stealOrder + 1, stealOrder + queueCount, [thiefRanks](uint32_t victimA, uint32_t victimB)
+            {
+                return thiefRanks[victimA] < thiefRanks[victimB];
+            });
+        }
+
+        resource.m_StealOrder.store(newStealOrder.get(), std::memory_order_release);
+        resource.m_StealOrders.push_back(std::move(newStealOrder));
+    }
+
+    // Spins until there is something for the worker to do, or the poll time is over. Returns true in the former case.
+    // The clock is read every few iterations only, as reading it takes longer than checking for work.
+    static bool PollForWork(InternalState& state, PriorityResources& resource, const Mailbox& mailbox, uint32_t threadID, Duration pollTime)
+    {
+        constexpr uint32_t checksPerClockRead = 64;
+        const TimePoint pollEnd = std::chrono::steady_clock::now() + pollTime;
+        do
+        {
+            for (uint32_t i = 0; i < checksPerClockRead; i++)
+            {
+                if (resource.m_QueuedJobCount.load(std::memory_order_relaxed) > 0 || !mailbox.IsEmpty() || !resource.IsWorkerActive(threadID) || !state.m_IsAlive.load(std::memory_order_relaxed))
+                {
+                    return true;
+                }
+                CPURelax();
+            }
+        } while (std::chrono::steady_clock::now() < pollEnd);
+        return false;
+    }
+
+    static void SpawnWorker(PriorityResources& resource, uint32_t threadID)
+    {
+        InternalState& state = *resource.m_State;
+        const Priority priorityType = resource.m_PriorityType;
+        std::thread& workerThread = resource.m_Threads[threadID];
+        workerThread = std::thread([threadID, priorityType, &resource, &state]
+        {
+            // The thread handle is published by SpawnWorker() under the spawn lock. Taking it once here means the handle is set before this worker executes a job,
+            // and with that before any waiter could find it executing a context and boost it.
+            {
+                std::scoped_lock spawnLock(resource.m_SpawnLock);
+            }
+
+            t_WorkerPriority = priorityType;
+            t_WorkerState = &resource.m_WorkerStates[threadID];
+            t_ThreadID = t_WorkerState->m_ThreadID;
+            t_ThreadRegistration = &state;
+            t_WorkerScheduler = &state;
+            SetCurrentThreadNiceness(priorityType);
+            Mailbox& mailbox = *state.FindMailbox(t_ThreadID);
+            const bool isTimerKeeper = (priorityType == Priority::High && threadID == 0);
+            bool isStackPrefaulted = false;
+
+            while (state.m_IsAlive.load())
+            {
+                const Duration pollTime = Duration(resource.m_PollTime.load(std::memory_order_relaxed));
+                if (pollTime > Duration::zero() && !isStackPrefaulted)
+                {
+                    PrefaultCurrentThreadStack();
+                    isStackPrefaulted = true;
+                }
+
+                state.RunPending();
+
+                // Parked by the thread count controller, or a spare with no blocked worker to stand in for. Only pinned jobs are still executed.
+                if (!resource.IsWorkerActive(threadID))
+                {
+                    std::unique_lock<std::mutex> lock(resource.m_WakeMutex);
+                    resource.m_ParkCondition.wait(lock, [&]()
+                    {
+                        return resource.IsWorkerActive(threadID) || !mailbox.IsEmpty() || !state.m_IsAlive.load();
+                    });
+                    continue;
+                }
+
+                // Under the make jobserver, queued jobs are only executed while holding a token, which is handed back once the queues run dry.
+                // Waiting for a token is bounded, so the worker keeps executing its pinned jobs and notices shutdown in the meantime.
+                const bool isJobServerEnabled = state.m_IsJobServerEnabled.load(std::memory_order_relaxed);
+                bool holdsJobToken = false;
+                char jobToken = 0;
+                if (isJobServerEnabled && resource.m_QueuedJobCount.load() > 0)
+                {
+                    holdsJobToken = state.m_JobServer.Acquire(jobToken, JobTokenWaitTime);
+                    if (!holdsJobToken)
+                    {
+                        state.ServiceTimers(); // Timers don't need a token. Left waiting on one, the timer keeper would hold them all up.
+                        continue;
+                    }
+                }
+
+                if (!isJobServerEnabled || holdsJobToken)
+                {
+                    resource.Work(threadID, threadID);
+                    state.WorkInherited(priorityType);
+                }
+                if (holdsJobToken)
+                {
+                    state.m_JobServer.Release(jobToken);
+                }
+                state.ServiceTimers();
+                state.RunPending();
+
+                if (pollTime > Duration::zero() && PollForWork(state, resource, mailbox, threadID, pollTime))
+                {
+                    continue;
+                }
+
+                // Blocks freed on behalf of other threads would otherwise be held back for as long as we sleep.
+                FlushRemoteFrees();
+
+                // Once jobs are complete, the thread is put to sleep until it is woken up again.
+                // The timer keeper sleeps no longer than the next timer expiry, so timers fire even when no other work arrives.
+                // Polling workers sleep for the rest of their poll period at most.
+                std::unique_lock<std::mutex> lock(resource.m_WakeMutex);
+                if (!mailbox.IsEmpty())
+                {
+                    continue; // Pinned jobs are only ever executed by us. ExecuteOn() notifies under this lock, so anything later is not missed.
+                }
+
+                TimePoint wakeTime = isTimerKeeper ? state.m_TimerWheel.GetNextExpiry() : NoDeadline;
+                if (pollTime > Duration::zero())
+                {
+                    wakeTime = std::min(wakeTime, std::chrono::steady_clock::now() + Duration(resource.m_PollSleepTime.load(std::memory_order_relaxed)));
+                }
+
+                resource.m_IdleThreadCount.fetch_add(1);
+                if (wakeTime != NoDeadline)
+                {
+                    resource.m_WakeCondition.wait_until(lock, wakeTime);
+                }
+                else
+                {
+                    resource.m_WakeCondition.wait(lock);
+                }
+                resource.m_IdleThreadCount.fetch_sub(1);
+            }
+        });
+
+        std::thread::native_handle_type threadHandle = workerThread.native_handle();
+        resource.m_WorkerStates[threadID].m_ThreadHandle = threadHandle;
+
+        // Put each thread on a dedicated core.
+        SetThreadAffinity(threadHandle, GetWorkerCore(resource, threadID));
+        SetOSThreadPriority(threadHandle, priorityType);
+        if (const int fifoPriority = resource.m_FIFOPriority.load(); fifoPriority > 0)
+        {
+            SetRealTimeThreadPriority(threadHandle, fifoPriority);
+        }
+        SetThreadName(threadHandle, priorityType, threadID);
+    }
+
+    // Calculate the actual number of worker threads we want. We want all threads to be assigned a core accordingly.
+    static uint32_t GetPoolThreadCount(Priority priorityType, uint32_t coreCount)
+    {
+        switch (priorityType)
+        {
+        case Priority::High:
+            return std::max(coreCount, 2u) - 1; // -1 for the main thread.
+        case Priority::Low:
+            return std::max(coreCount, 3u) - 2; // -1 for the main thread, -1 for streaming.
+        case Priority::Streaming:
+            return 1;
+        default:
+            assert(0);
+            return 1;
+        }
+    }
+
+    // Requested cores the process is currently allowed on. If none are, such as with a list made for another machine, the affinity of the process is left out.
+    // So it is for topologies not read from this machine, as its affinity refers to other cores.
+    static std::vector<uint32_t> SelectGrantedCores(const InternalState& state)
+    {
+        if (!state.m_Topology.m_IsMachineTopology)
+        {
+            return state.SelectCores({});
+        }
+
+        std::vector<uint32_t> cores = state.SelectCores(GetProcessAffinity());
+        return cores.empty() ? state.SelectCores({}) : cores;
+    }
+
+    // Container runtimes and taskset may change the cores and CPU quota granted to the process while it runs, so these are re-read periodically.
+    // Workers are re-pinned if their cores changed, and each pool only keeps as many workers active as the quota covers, so that the process
+    // isn't throttled for using more CPU time than it was granted.
+    static void UpdateCPUBudget(InternalState& state)
+    {
+        const std::vector<uint32_t> cores = SelectGrantedCores(state);
+        bool haveCoresChanged = false;
+        {
+            std::scoped_lock lock(state.m_CoreLock);
+            haveCoresChanged = cores != state.m_Cores;
+            if (haveCoresChanged)
+            {
+                state.AssignCores(cores);
+            }
+        }
+
+        const uint32_t quota = GetCPUQuota();
+        for (PriorityResources& resource : state.m_Resources)
+        {
+            if (haveCoresChanged)
+            {
+                std::scoped_lock lock(resource.m_SpawnLock);
+                for (uint32_t threadID = 0; threadID < resource.GetWorkerCapacity(); threadID++)
+                {
+                    if (resource.m_Threads[threadID].joinable())
+                    {
+                        SetThreadAffinity(resource.m_WorkerStates[threadID].m_ThreadHandle, GetWorkerCore(resource, threadID));
+                    }
+                }
+                BuildStealOrder(resource); // Workers now sit on other cores, so their distances changed too.
+            }
+
+            uint32_t budgetCoreCount = 0;
+            {
+                std::scoped_lock lock(state.m_CoreLock);
+                budgetCoreCount = (uint32_t)state.m_PoolCores[int(resource.m_PriorityType)].size();
+                if (resource.m_PriorityType == Priority::High && !state.m_RealTimeCores.empty())
+                {
+                    budgetCoreCount = (uint32_t)state.m_RealTimeCores.size() + 1; // The main thread isn't on the isolated cores, so each gets a worker.
+                }
+            }
+            budgetCoreCount = quota > 0 ? std::min(budgetCoreCount, quota) : budgetCoreCount;
+
+            const uint32_t threadBudget = std::clamp(GetPoolThreadCount(resource.m_PriorityType, budgetCoreCount), 1u, resource.m_ThreadCount);
+            if (resource.m_ThreadBudget.exchange(threadBudget) < threadBudget)
+            {
+                std::scoped_lock lock(resource.m_WakeMutex);
+                resource.m_ParkCondition.notify_all();
+            }
+        }
+    }
+
+    Scheduler::Scheduler(uint32_t maxThreadCount, const std::vector<uint32_t>& cores, CorePlacement placement) : m_State(std::make_unique<InternalState>())
+    {
+        InternalState& state = *m_State;
+        state.m_TimerContext.m_Scheduler = this;
+        state.m_CPUBudgetContext.m_Scheduler = this;
+        state.m_CPUBudgetContext.m_Priority = Priority::Streaming;
+        maxThreadCount = std::max(1u, maxThreadCount); // 1 for our main thread.
+
+        state.m_RequestedCores = cores;
+        state.m_CorePlacement = placement;
+        state.m_Topology.Discover(GetTopologyRoot());
+        state.AssignCores(SelectGrantedCores(state));
+        assert(!state.m_Cores.empty());
+        state.m_CoreCount = (uint32_t)state.m_Cores.size();
+
+        for (int priorityTypeIndex = 0; priorityTypeIndex < int(Priority::Count); priorityTypeIndex++)
+        {
+            const Priority priorityType = (Priority)priorityTypeIndex;
+            PriorityResources& resource = state.m_Resources[priorityTypeIndex];
+            resource.m_State = &state;
+            resource.m_PriorityType = priorityType;
+
+            // Pools are sized after the cores assigned to them. The CPU quota only limits how many of the workers are active, as it may be raised later.
+            resource.m_ThreadCount = std::clamp(GetPoolThreadCount(priorityType, (uint32_t)state.m_PoolCores[priorityTypeIndex].size()), 1u, maxThreadCount);
+            resource.m_ActiveThreadCount.store(resource.m_ThreadCount);
+            resource.m_JobQueuesPerThread.reset(new JobQueue[resource.m_ThreadCount]);
+            BuildStealOrder(resource);
+            resource.m_InjectionQueue.Reset(InjectionQueueCapacity);
+            resource.m_SpareThreadCount = resource.m_ThreadCount;
+            resource.m_WorkerStates.reset(new WorkerState[resource.GetWorkerCapacity()]);
+            for (uint32_t threadID = 0; threadID < resource.GetWorkerCapacity(); threadID++)
+            {
+                resource.m_WorkerStates[threadID].m_ThreadID = state.CreateMailbox();
+            }
+            resource.m_Threads.reset(new std::thread[resource.GetWorkerCapacity()]);
+        }
+
+        // The threads servicing the timers include the real-time timer keeper and the main thread in Wait(), neither of which should wait on file reads.
+        // So the timer only hands the recheck to the streaming pool, unless the previous one is still pending there.
+        UpdateCPUBudget(state);
+        state.m_CPUBudgetTimerID = state.ScheduleTimer(std::chrono::steady_clock::now() + CPUBudgetRecheckInterval, CPUBudgetRecheckInterval, TimerWheel::MakeCallback([&state]()
+        {
+            if (!IsBusy(state.m_CPUBudgetContext))
+            {
+                SubmitTask(state.m_CPUBudgetContext, [&state](JobArguments) { UpdateCPUBudget(state); }, NoDeadline, false);
+            }
+        }), false);
+    }
+
+    Scheduler::~Scheduler()
+    {
+        CancelTimer(m_State->m_CPUBudgetTimerID);
+        m_State->Shutdown();
+    }
+
+    Scheduler& GetDefaultScheduler()
+    {
+        assert(g_DefaultScheduler != nullptr);
+        return *g_DefaultScheduler;
+    }
+
+    void Initialize(uint32_t maxThreadCount, CorePlacement placement)
+    {
+        g_DefaultScheduler = new Scheduler(maxThreadCount, {}, placement);
+
+        // Post message to logging system.
+        char logMessage[256] = {};
+        snprintf(logMessage, sizeof(logMessage), "Cyclone initialized with %d Cores!\nHigh Priority Threads: %d\nLow Priority Threads: %d\nStreaming Threads: %d", g_DefaultScheduler->m_State->m_CoreCount, GetThreadCount(Priority::High), GetThreadCount(Priority::Low), GetThreadCount(Priority::Streaming));
+        std::cout << logMessage << "\n\n";
+    }
+
+    void Shutdown()
+    {
+        delete g_DefaultScheduler;
+        g_DefaultScheduler = nullptr;
+    }
+
+    uint32_t Scheduler::GetThreadCount(Priority priorityType) const
+    {
+        return m_State->m_Resources[int(priorityType)].m_ThreadCount;
+    }
+
+    uint32_t GetThreadCount(Priority priorityType)
+    {
+        return GetDefaultScheduler().GetThreadCount(priorityType);
+    }
+
+    bool IsBusy(const Context& executionContext)
+    {
+        return executionContext.m_JobCounter.load() > 0; // m_JobCounter denotes the number of jobs that still needs to be executed.
+    }
+
+    void Wait(const Context& executionContext)
+    {
+        if (IsBusy(executionContext))
+        {
+            InternalState& state = GetState(executionContext);
+            PriorityResources& resource = state.m_Resources[int(executionContext.m_Priority)];
+
+            // A higher priority thread waiting on lower priority work lends its priority to that work for the duration of the wait.
+            const Priority waiterPriority = GetCallerPriority();
+            const bool inheritsPriority = int(waiterPriority) < int(executionContext.m_Priority);
+            BoostedWorkerList boostedWorkers;
+            if (inheritsPriority)
+            {
+                state.BeginPriorityInheritance(executionContext, waiterPriority);
+            }
+
+            // Wake any threads that might be sleeping.
+            resource.m_WakeCondition.notify_all();
+
+            // Work() will pick up any jobs that are still waiting and execute them on this thread. Jobs queued later, such as by the jobs of the context,
+            // are picked up on the way, so the waiter keeps executing even while the workers are short of jobserver tokens. It uses the implicit slot of the process.
+            const uint32_t queueIndex = resource.m_NextQueueIndex.fetch_add(1) % resource.m_ThreadCount;
+            resource.Work(queueIndex);
+
+            while (IsBusy(executionContext))
+            {
+                if (resource.m_QueuedJobCount.load(std::memory_order_relaxed) > 0)
+                {
+                    resource.Work(queueIndex);
+                }
+
+                if (inheritsPriority)
+                {
+                    resource.BoostWorkersExecuting(&executionContext, waiterPriority, boostedWorkers);
+                }
+
+                state.ServiceTimers(); // The context may be waiting on delayed jobs.
+                state.RunPending();    // Or on jobs pinned to this very thread.
+
+                // If we're here, it means there are jobs that couldn't be picked up by this thread.
+                // In this case, it means there are jobs that are in the process of executing.
+                // We will allow the thread to be swapped out by the OS to avoid spinning endlessly.
+                std::this_thread::yield();
+            }
+
+            if (inheritsPriority)
+            {
+                resource.RestoreBoostedWorkers(boostedWorkers);
+                state.EndPriorityInheritance(executionContext);
+            }
+        }
+    }
+
+    uint32_t GetDispatchGroupCount(uint32_t jobCount, uint32_t groupSize)
+    {
+        // Calculates the amount of job groups to dispatch. We will overestimate here.
+        return (jobCount + groupSize - 1) / groupSize;
+    }
+
+    // Dispatch() splits its groups into contiguous runs, one per queue, so each worker covers a contiguous range of the data, in the same place every time.
+    // FirstTouch() relies on this to place memory on the NUMA node of the worker processing it. Stealing still evens out the load.
+    static uint32_t GetDispatchQueueIndex(uint32_t groupID, uint32_t groupCount, uint32_t queueCount)
+    {
+        return (uint32_t)((uint64_t)groupID * queueCount / groupCount);
+    }
+
+    // First group placed on the queue, the inverse of the above.
+    static uint32_t GetDispatchQueueGroupBegin(uint32_t queueIndex, uint32_t groupCount, uint32_t queueCount)
+    {
+        return (uint32_t)(((uint64_t)queueIndex * groupCount + queueCount - 1) / queueCount);
+    }
+
+    // Queues a job under the limits of its priority. Depending on the policy, full queues either make the submitter help execute queued jobs until there is room, or fail the submission.
+    // Submissions of several jobs pass the policy they started out with, so one changed midway can't reject jobs of a call that already queued others.
+    static SubmitStatus SubmitWithBackpressure(PriorityResources& resource, Job&& newJob, BackpressurePolicy policy, uint32_t preferredQueueIndex = AnyQueueIndex)
+    {
+        while (!resource.TryPushBack(std::move(newJob), preferredQueueIndex))
+        {
+            if (policy == BackpressurePolicy::FailFast)
+            {
+                return SubmitStatus::QueueFull;
+            }
+
+            // Make sure nothing queued so far sits unnoticed while we help.
+            resource.m_WakeCondition.notify_all();
+            if (!resource.ExecuteNext())
+            {
+                std::this_thread::yield(); // Everything queued is being executed. Room will free up shortly.
+            }
+        }
+        return SubmitStatus::Submitted;
+    }
+
+    // User submissions are subject to the queue limits, and tiny ones are executed inline while the pool is saturated. Internal submissions, such as a strand
+    // requeueing itself, are always queued and bypass the limits, as they were admitted once already.
+    static SubmitStatus SubmitTask(Context& executionContext, std::function<void(JobArguments)> task, TimePoint deadline, bool isUserSubmission)
+    {
+        InternalState& state = GetState(executionContext);
+        PriorityResources& resource = state.m_Resources[int(executionContext.m_Priority)];
+
+        // Update execution context.
+        executionContext.m_JobCounter.fetch_add(1);
+
+        Job newJob;
+        newJob.m_Context = &executionContext;
+        newJob.m_JobClass = executionContext.m_JobClass;
+        newJob.m_Task = std::move(task);
+        newJob.m_GroupID = 0;
+        newJob.m_GroupJobOffset = 0;
+        newJob.m_GroupJobEnd = 1;
+        newJob.m_SharedMemorySize = 0;
+        newJob.m_Deadline = deadline;
+        newJob.m_SchedulingKey = state.GetSchedulingKey(deadline, std::chrono::steady_clock::now());
+
+        if (!isUserSubmission)
+        {
+            resource.PushBack(std::move(newJob));
+            return SubmitStatus::Submitted;
+        }
+
+        // Work first. While every worker is busy with a backlog, executing a tiny job here beats queueing it behind that backlog.
+        // Only workers of this scheduler do so, and only for pools of their own priority or below, so the main thread, real-time threads and
+        // workers of other schedulers are never held up by a job. Jobs without a cost hint might run for any length of time, so they are always queued.
+        const bool isSameOrHigherPriorityWorker = t_WorkerScheduler == &state && t_WorkerPriority <= executionContext.m_Priority;
+        if (isSameOrHigherPriorityWorker && IsTinyJob(executionContext) && resource.IsSaturated())
+        {
+            newJob.Execute();
+            return SubmitStatus::Submitted;
+        }
+
+        if (SubmitWithBackpressure(resource, std::move(newJob), resource.m_BackpressurePolicy.load()) == SubmitStatus::QueueFull)
+        {
+            executionContext.m_JobCounter.fetch_sub(1);
+            return SubmitStatus::QueueFull;
+        }
+
+        resource.m_WakeCondition.notify_one(); // All threads in the resource wait on this wake condition. This guarantees one awaiting thread is woken up to handle the job.
+        return SubmitStatus::Submitted;
+    }
+
+    SubmitStatus SubmitBatch(Context& executionContext, const std::function<void(JobArguments)>* tasks, uint32_t taskCount)
+    {
+        if (taskCount == 0)
+        {
+            return SubmitStatus::Submitted;
+        }
+
+        InternalState& state = GetState(executionContext);
+        PriorityResources& resource = state.m_Resources[int(executionContext.m_Priority)];
+        const bool isFailFast = resource.m_BackpressurePolicy.load() == BackpressurePolicy::FailFast;
+        const bool isReserved = resource.TryReserve(taskCount);
+        if (!isReserved && isFailFast)
+        {
+            return SubmitStatus::QueueFull;
+        }
+
+        std::vector<Job, SizeClassAllocator<Job>> newJobs(taskCount);
+        const TimePoint schedulingKey = state.GetSchedulingKey(executionContext.m_Deadline, std::chrono::steady_clock::now());
+        for (uint32_t i = 0; i < taskCount; i++)
+        {
+            Job& newJob = newJobs[i];
+            newJob.m_Context = &executionContext;
+            newJob.m_JobClass = executionContext.m_JobClass;
+            newJob.m_Task = tasks[i];
+            newJob.m_GroupJobEnd = 1;
+            newJob.m_Deadline = executionContext.m_Deadline;
+            newJob.m_SchedulingKey = schedulingKey;
+        }
+
+        // Fail fast batches must also fit into the per thread capacities, which are checked and filled with every queue locked, as for Dispatch().
+        if (isFailFast)
+        {
+            resource.LockQueues();
+            if (resource.GetLockedQueueRoom() < taskCount)
+            {
+                resource.UnlockQueues();
+                resource.m_QueuedJobCount.fetch_sub(taskCount);
+                return SubmitStatus::QueueFull;
+            }
+
+            executionContext.m_JobCounter.fetch_add(taskCount);
+            const uint32_t startingQueueIndex = resource.m_NextQueueIndex.fetch_add(1);
+            for (uint32_t i = 0; i < taskCount; i++)
+            {
+                resource.PlaceLocked(std::move(newJobs[i]), (startingQueueIndex + i) % resource.m_ThreadCount);
+            }
+            resource.UnlockQueues();
+            resource.Wake(taskCount);
+            return SubmitStatus::Submitted;
+        }
+
+        // Update execution context.
+        executionContext.m_JobCounter.fetch_add(taskCount);
+
+        // The batch didn't fit as a whole. Fall back to submitting the jobs one by one, helping out whenever the queues are full, even if the policy
+        // changed to fail fast since. Some jobs may already be queued, so none can be rejected any more.
+        if (!isReserved)
+        {
+            for (Job& newJob : newJobs)
+            {
+                SubmitWithBackpressure(resource, std::move(newJob), BackpressurePolicy::Help);
+            }
+            resource.Wake(taskCount);
+            return SubmitStatus::Submitted;
+        }
+
+        // Split the batch evenly over the worker queues, taking each queue lock once. Whatever the per thread capacities leave over moves on to the next queue.
+        const uint32_t startingQueueIndex = resource.m_NextQueueIndex.fetch_add(1);
+        uint32_t submittedJobCount = 0;
+        for (uint32_t i = 0; i < resource.m_ThreadCount && submittedJobCount < taskCount; i++)
+        {
+            JobQueue& jobQueue = resource.m_JobQueuesPerThread[(startingQueueIndex + i) % resource.m_ThreadCount];
+            const uint32_t remainingQueueCount = resource.m_ThreadCount - i;
+            const uint32_t sliceSize = (taskCount - submittedJobCount + remainingQueueCount - 1) / remainingQueueCount;
+            submittedJobCount += jobQueue.TryPushBatch(&newJobs[submittedJobCount], sliceSize);
+        }
+
+        resource.Wake(submittedJobCount);
+
+        // Reserved, but no queue had room. Under the help policy, the submitter executes them here rather than overfilling.
+        for (uint32_t i = submittedJobCount; i < taskCount; i++)
+        {
+            resource.m_QueuedJobCount.fetch_sub(1);
+            newJobs[i].Execute();
+        }
+
+        return SubmitStatus::Submitted;
+    }
+
+    // Coalescing only pays off if the job would sit in a queue for a while anyway. Otherwise a worker would seal the batch before anything could be appended.
+    // Payloads of a batch execute one after another, so only jobs hinted to be tiny are coalesced. Saturated pools may execute those inline instead.
+    static bool ShouldStartCoalescedBatch(const Context& executionContext, const PriorityResources& resource, const std::function<void(JobArguments)>& task)
+    {
+        return resource.m_State->m_IsCoalescingEnabled.load(std::memory_order_relaxed) && IsTinyJob(executionContext) && !resource.IsSaturated() &&
+               task.target_type() != typeid(void) && resource.m_QueuedJobCount.load(std::memory_order_relaxed) >= resource.m_ThreadCount;
+    }
+
+    // Singular task in its own group.
+    SubmitStatus Execute(Context& executionContext, std::function<void(JobArguments)> task)
+    {
+        // Counted before appending, as the batch may be executed the moment the payload is published. Appended payloads count as queued jobs
+        // towards the queue limits, just as if they had been queued on their own. Without room, the job goes through the regular path and its policy.
+        PriorityResources& resource = GetState(executionContext).m_Resources[int(executionContext.m_Priority)];
+        std::shared_ptr<CoalescedBatch>& coalescedBatch = t_CoalescedBatch;
+        if (coalescedBatch != nullptr && coalescedBatch->m_Context == &executionContext && *coalescedBatch->m_CallableType == task.target_type() &&
+            resource.TryReserve(1))
+        {
+            executionContext.m_JobCounter.fetch_add(1);
+            if (coalescedBatch->TryAppend(std::move(task)))
+            {
+                return SubmitStatus::Submitted;
+            }
+            executionContext.m_JobCounter.fetch_sub(1);
+            resource.m_QueuedJobCount.fetch_sub(1);
+        }
+
+        coalescedBatch.reset(); // Only consecutive calls are coalesced, so an unrelated submission in between ends the batch.
+
+        if (!ShouldStartCoalescedBatch(executionContext, resource, task))
+        {
+            return SubmitTask(executionContext, std::move(task), executionContext.m_Deadline, true);
+        }
+
+        std::shared_ptr<CoalescedBatch> newBatch = std::allocate_shared<CoalescedBatch>(SizeClassAllocator<CoalescedBatch>());
+        newBatch->m_Context = &executionContext;
+        newBatch->m_CallableType = &task.target_type();
+        newBatch->TryAppend(std::move(task));
+
+        newBatch->m_Resource = &resource;
+        newBatch->m_Self = newBatch;
+
+        // The job itself accounts for one payload. The rest are accounted for here, and leave the queue once the batch is sealed.
+        CoalescedBatch* batch = newBatch.get();
+        const SubmitStatus submitStatus = SubmitTask(executionContext, [batch](JobArguments jobArguments)
+        {
+            const std::shared_ptr<CoalescedBatch> self = std::move(batch->m_Self);
+            Context& executionContext = *batch->m_Context;
+            const uint32_t payloadCount = batch->Seal();
+            batch->m_Resource->m_QueuedJobCount.fetch_sub(payloadCount - 1);
+            batch->Execute(payloadCount, jobArguments);
+            batch->m_Resource->m_CompletedJobCount.fetch_add(payloadCount - 1, std::memory_order_relaxed); // The thread count controller measures payloads, not batches.
+            if (executionContext.m_Deadline != NoDeadline && payloadCount > 1)
+            {
+                GetState(executionContext).RecordDeadline(executionContext.m_Deadline, std::chrono::steady_clock::now(), payloadCount - 1);
+            }
+            executionContext.m_JobCounter.fetch_sub(payloadCount - 1);
+        }, executionContext.m_Deadline, true);
+
+        if (submitStatus == SubmitStatus::Submitted)
+        {
+            coalescedBatch = std::move(newBatch);
+        }
+        else
+        {
+            newBatch->m_Self.reset(); // The job never made it into a queue.
+        }
+        return submitStatus;
+    }
+
+    SubmitStatus Execute(Context& executionContext, std::function<void(JobArguments)> task, TimePoint deadline)
+    {
+        return SubmitTask(executionContext, std::move(task), deadline, true);
+    }
+
+    SubmitStatus TryExecute(Context& executionContext, std::function<void(JobArguments)>&& task)
+    {
+        PriorityResources& resource = GetState(executionContext).m_Resources[int(executionContext.m_Priority)];
+        if (!resource.m_IsStarted.load(std::memory_order_acquire))
+        {
+            return SubmitStatus::NotStarted;
+        }
+
+        if (!resource.TryReserveStarted(1))
+        {
+            return SubmitStatus::QueueFull;
+        }
+        executionContext.m_JobCounter.fetch_add(1);
+
+        Job newJob;
+        newJob.m_Context = &executionContext;
+        newJob.m_JobClass = executionContext.m_JobClass;
+        newJob.m_Task = std::move(task);
+        newJob.m_GroupJobEnd = 1;
+        newJob.m_Deadline = executionContext.m_Deadline;
+        newJob.m_SchedulingKey = resource.m_State->GetSchedulingKey(newJob.m_Deadline, std::chrono::steady_clock::now());
+        if (!resource.m_InjectionQueue.TryPush(std::move(newJob)))
+        {
+            task = std::move(newJob.m_Task); // Handed back, so the caller can retry without building the task again.
+            executionContext.m_JobCounter.fetch_sub(1);
+            resource.m_QueuedJobCount.fetch_sub(1);
+            return SubmitStatus::QueueFull;
+        }
+
+        resource.m_WakeCondition.notify_one();
+        return SubmitStatus::Submitted;
+    }
+
+    Strand::Strand(Context& executionContext) : m_Context(executionContext), m_Queue(std::make_unique<StrandQueue>())
+    {
+    }
+
+    Strand::~Strand()
+    {
+        assert(m_PendingCount.load() == 0);
+    }
+
+    // Strands are serviced by a regular job which executes pending tasks one after another. Only one such job exists per strand at any time.
+    // After a batch of tasks, it requeues itself rather than monopolizing the worker, so other work gets its turn.
+    static void ExecuteStrand(Strand& strand)
+    {
+        constexpr uint32_t maxTasksPerBatch = 32;
+
+        JobArguments jobArguments = {};
+        jobArguments.m_IsFirstJobInGroup = true;
+        jobArguments.m_IsLastJobInGroup = true;
+
+        std::function<void(JobArguments)> task;
+        for (uint32_t taskIndex = 0; taskIndex < maxTasksPerBatch; taskIndex++)
+        {
+            // The pending count guarantees a task is on its way, but its producer may not have linked it in yet.
+            while (!strand.m_Queue->TryPop(task))
+            {
+                std::this_thread::yield();
+            }
+
+            task(jobArguments);
+            task = nullptr;
+
+            Context& executionContext = strand.m_Context;
+            const bool isStrandDrained = strand.m_PendingCount.fetch_sub(1) == 1;
+            executionContext.m_JobCounter.fetch_sub(1); // The strand may be destroyed once this reaches zero, so it must not be touched past this point if drained.
+            if (isStrandDrained)
+            {
+                return;
+            }
+        }
+
+        SubmitTask(strand.m_Context, [&strand](JobArguments) { ExecuteStrand(strand); }, strand.m_Context.m_Deadline, false);
+    }
+
+    void Execute(Strand& strand, std::function<void(JobArguments)> task)
+    {
+        strand.m_Context.m_JobCounter.fetch_add(1);
+        strand.m_Queue->Push(std::move(task));
+
+        // If the strand was idle, nobody is servicing it. Schedule it.
+        if (strand.m_PendingCount.fetch_add(1) == 0)
+        {
+            SubmitTask(strand.m_Context, [&strand](JobArguments) { ExecuteStrand(strand); }, strand.m_Context.m_Deadline, false);
+        }
+    }
+
+    // Owned by whichever job is stepping it, and freed by the one that finds it done. Jobs only capture a pointer to it, so requeueing doesn't allocate.
+    struct ResumableTask
+    {
+        std::function<JobStatus(JobArguments)> m_Task;
+        Context* m_Context = nullptr;
+        Duration m_TimeSlice;
+    };
+
+    // Steps the task until it is done or its time slice runs out, in which case it requeues itself. The context stays busy throughout,
+    // as the next slice is counted before the current one completes.
+    static void ExecuteTimeSlice(ResumableTask* resumableTask, JobArguments jobArguments)
+    {
+        const TimePoint sliceEnd = std::chrono::steady_clock::now() + resumableTask->m_TimeSlice;
+        do
+        {
+            if (resumableTask->m_Task(jobArguments) == JobStatus::Done)
+            {
+                resumableTask->~ResumableTask();
+                SizeClassFree(resumableTask, sizeof(ResumableTask));
+                return;
+            }
+        } while (std::chrono::steady_clock::now() < sliceEnd);
+
+        Context& executionContext = *resumableTask->m_Context;
+        SubmitTask(executionContext, [resumableTask](JobArguments jobArguments) { ExecuteTimeSlice(resumableTask, jobArguments); }, executionContext.m_Deadline, false);
+    }
+
+    void ExecuteResumable(Context& executionContext, const std::function<JobStatus(JobArguments)>& task, Duration timeSlice)
+    {
+        ResumableTask* resumableTask = new (SizeClassAlloc(sizeof(ResumableTask))) ResumableTask();
+        resumableTask->m_Task = task;
+        resumableTask->m_Context = &executionContext;
+        resumableTask->m_TimeSlice = timeSlice;
+
+        SubmitTask(executionContext, [resumableTask](JobArguments jobArguments) { ExecuteTimeSlice(resumableTask, jobArguments); }, executionContext.m_Deadline, false);
+    }
+
+    void ExecuteAfter(Context& executionContext, Duration delay, std::function<void(JobArguments)> task)
+    {
+        // Counted right away, and handed over to the submitted job once due.
+        executionContext.m_JobCounter.fetch_add(1);
+        GetState(executionContext).ScheduleTimer(std::chrono::steady_clock::now() + delay, Duration::zero(), TimerWheel::MakeCallback([&executionContext, task = std::move(task)]() mutable
+        {
+            SubmitTask(executionContext, std::move(task), executionContext.m_Deadline, false); // Fires once, so the task can be handed over.
+            executionContext.m_JobCounter.fetch_sub(1);
+        }));
+    }
+
+    TimerID ExecuteEvery(Context& executionContext, Duration period, const std::function<void(JobArguments)>& task)
+    {
+        period = std::max<Duration>(period, TimerWheel::TickDuration);
+        return GetState(executionContext).ScheduleTimer(std::chrono::steady_clock::now() + period, period, TimerWheel::MakeCallback([&executionContext, task]()
+        {
+            SubmitTask(executionContext, task, executionContext.m_Deadline, false);
+        }));
+    }
+
+    TimerID Scheduler::ExecuteEvery(Duration period, const std::function<void(JobArguments)>& task)
+    {
+        return Cyclone::ExecuteEvery(m_State->m_TimerContext, period, task);
+    }
+
+    TimerID ExecuteEvery(Duration period, const std::function<void(JobArguments)>& task)
+    {
+        return GetDefaultScheduler().ExecuteEvery(period, task);
+    }
+
+    void Scheduler::CancelTimer(TimerID timerID)
+    {
+        m_State->m_TimerWheel.Cancel(timerID);
+    }
+
+    void CancelTimer(TimerID timerID)
+    {
+        GetDefaultScheduler().CancelTimer(timerID);
+    }
+
+    ThreadID Scheduler::RegisterThread()
+    {
+        if (m_State->GetCurrentThreadID() == InvalidThreadID)
+        {
+            t_ThreadID = m_State->CreateMailbox();
+            t_ThreadRegistration = m_State.get();
+        }
+        return t_ThreadID;
+    }
+
+    ThreadID RegisterThread()
+    {
+        return GetDefaultScheduler().RegisterThread();
+    }
+
+    ThreadID Scheduler::GetCurrentThreadID() const
+    {
+        return m_State->GetCurrentThreadID();
+    }
+
+    ThreadID GetCurrentThreadID()
+    {
+        return GetDefaultScheduler().GetCurrentThreadID();
+    }
+
+    ThreadID Scheduler::GetWorkerThreadID(Priority priority, uint32_t threadIndex) const
+    {
+        const PriorityResources& resource = m_State->m_Resources[int(priority)];
+        return threadIndex < resource.m_ThreadCount ? resource.m_WorkerStates[threadIndex].m_ThreadID : InvalidThreadID;
+    }
+
+    ThreadID GetWorkerThreadID(Priority priority, uint32_t threadIndex)
+    {
+        return GetDefaultScheduler().GetWorkerThreadID(priority, threadIndex);
+    }
+
+    SubmitStatus ExecuteOn(ThreadID threadID, Context& executionContext, std::function<void(JobArguments)> task)
+    {
+        InternalState& state = GetState(executionContext);
+        Mailbox* mailbox = state.FindMailbox(threadID);
+        if (mailbox == nullptr)
+        {
+            return SubmitStatus::UnknownThread;
+        }
+        executionContext.m_JobCounter.fetch_add(1);
+
+        Job newJob;
+        newJob.m_Context = &executionContext;
+        newJob.m_Task = std::move(task);
+        newJob.m_GroupJobEnd = 1;
+        newJob.m_Deadline = executionContext.m_Deadline;
+        mailbox->Push(std::move(newJob));
+
+        // If the target is one of our workers, it may be asleep. We can't wake a specific worker, so wake them all.
+        // Taking the wake lock first ensures the target is either still ahead of its mailbox check or already waiting.
+        for (PriorityResources& resource : state.m_Resources)
+        {
+            for (uint32_t i = 0; i < resource.GetWorkerCapacity(); i++)
+            {
+                if (resource.m_WorkerStates[i].m_ThreadID == threadID)
+                {
+                    resource.EnsureSpawned(i);
+                    {
+                        std::scoped_lock lock(resource.m_WakeMutex);
+                    }
+                    resource.m_WakeCondition.notify_all();
+                    resource.m_ParkCondition.notify_all();
+                    return SubmitStatus::Submitted;
+                }
+            }
+        }
+        return SubmitStatus::Submitted;
+    }
+
+    uint32_t Scheduler::RunPending()
+    {
+        return m_State->RunPending();
+    }
+
+    uint32_t RunPending()
+    {
+        return GetDefaultScheduler().RunPending();
+    }
+
+    // The task of a dispatch, shared by the jobs of all of its groups rather than copied into each. Jobs refer to it through a bare pointer, which
+    // std::function stores in place, so queueing a group allocates nothing. Freed by whichever group completes last.
+    struct DispatchTask
+    {
+        std::function<void(JobArguments)> m_Task;
+        std::atomic<uint32_t> m_RemainingGroupCount = 0;
+    };
+
+    SubmitStatus Dispatch(Context& executionContext, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArguments)>& task, size_t sharedMemorySize,
+                          size_t sharedMemoryAlignment, bool isSharedMemoryZeroed)
+    {
+        if (jobCount == 0 || groupSize == 0)
+        {
+            return SubmitStatus::Submitted;
+        }
+
+        // Checked in release builds too, as a truncated size would have the jobs run past the end of their shared memory.
+        if (sharedMemorySize > UINT32_MAX || sharedMemoryAlignment > UINT32_MAX)
+        {
+            return SubmitStatus::InvalidArgument;
+        }
+
+        InternalState& state = GetState(executionContext);
+        PriorityResources& resource = state.m_Resources[int(executionContext.m_Priority)];
+        // A job is generated per group. Tasks within the same group execute serially, using the aforementioned job.
+        const uint32_t groupCount = GetDispatchGroupCount(jobCount, groupSize);
+
+        // Fail fast dispatches are admitted as a whole, so they are never left half submitted. Both the total capacity and the per thread capacities
+        // must have room for every group. The queues stay locked until all groups are placed.
+        const bool isFailFast = resource.m_BackpressurePolicy.load() == BackpressurePolicy::FailFast;
+        if (isFailFast)
+        {
+            if (!resource.TryReserve(groupCount))
+            {
+                return SubmitStatus::QueueFull;
+            }
+
+            resource.LockQueues();
+            if (resource.GetLockedQueueRoom() < groupCount)
+            {
+                resource.UnlockQueues();
+                resource.m_QueuedJobCount.fetch_sub(groupCount);
+                return SubmitStatus::QueueFull;
+            }
+        }
+
+        // Update execution context.
+        executionContext.m_JobCounter.fetch_add(groupCount);
+
+        DispatchTask* dispatchTask = new (SizeClassAlloc(sizeof(DispatchTask))) DispatchTask();
+        dispatchTask->m_Task = task;
+        dispatchTask->m_RemainingGroupCount.store(groupCount, std::memory_order_relaxed);
+
+        Job newJob;
+        newJob.m_Context = &executionContext;
+        newJob.m_JobClass = executionContext.m_JobClass;
+        newJob.m_Task = [dispatchTask](JobArguments jobArguments)
+        {
+            dispatchTask->m_Task(jobArguments);
+            if (jobArguments.m_IsLastJobInGroup && dispatchTask->m_RemainingGroupCount.fetch_sub(1) == 1)
+            {
+                dispatchTask->~DispatchTask();
+                SizeClassFree(dispatchTask, sizeof(DispatchTask));
+            }
+        };
+        newJob.m_SharedMemorySize = (uint32_t)sharedMemorySize;
+        newJob.m_SharedMemoryAlignment = (uint32_t)sharedMemoryAlignment;
+        newJob.m_IsSharedMemoryZeroed = isSharedMemoryZeroed;
+        newJob.m_Deadline = executionContext.m_Deadline;
+        newJob.m_SchedulingKey = state.GetSchedulingKey(executionContext.m_Deadline, std::chrono::steady_clock::now());
+
+        for (uint32_t groupID = 0; groupID < groupCount; groupID++)
+        {
+            // For each group, generate one real job.
+            newJob.m_GroupID = groupID;
+            newJob.m_GroupJobOffset = groupID * groupSize;
+            newJob.m_GroupJobEnd = std::min(newJob.m_GroupJobOffset + groupSize, jobCount); // Prevents overflowing at the lasr group.
+            const uint32_t queueIndex = GetDispatchQueueIndex(groupID, groupCount, resource.m_ThreadCount);
+
+            if (isFailFast)
+            {
+                resource.PlaceLocked(Job(newJob), queueIndex);
+            }
+            else
+            {
+                // Earlier groups may already be executing, so later ones are admitted too, even if the policy changed to fail fast since.
+                SubmitWithBackpressure(resource, Job(newJob), BackpressurePolicy::Help, queueIndex);
+            }
+        }
+
+        if (isFailFast)
+        {
+            resource.UnlockQueues();
+        }
+
+        // Get all awaiting threads to pick off at the new jobs.
+        resource.m_WakeCondition.notify_all();
+
+        return SubmitStatus::Submitted;
+    }
+
+    void FirstTouch(Context& executionContext, uint32_t jobCount, uint32_t groupSize, const std::function<void(uint32_t, uint32_t)>& task)
+    {
+        if (jobCount == 0 || groupSize == 0)
+        {
+            return;
+        }
+
+        InternalState& state = GetState(executionContext);
+        PriorityResources& resource = state.m_Resources[int(executionContext.m_Priority)];
+        const uint32_t groupCount = GetDispatchGroupCount(jobCount, groupSize);
+        for (uint32_t queueIndex = 0; queueIndex < resource.m_ThreadCount; queueIndex++)
+        {
+            const uint32_t jobBegin = GetDispatchQueueGroupBegin(queueIndex, groupCount, resource.m_ThreadCount) * groupSize;
+            const uint32_t jobEnd = std::min(GetDispatchQueueGroupBegin(queueIndex + 1, groupCount, resource.m_ThreadCount) * groupSize, jobCount);
+            if (jobBegin < jobEnd)
+            {
+                ExecuteOn(resource.m_WorkerStates[queueIndex].m_ThreadID, executionContext, [&task, jobBegin, jobEnd](JobArguments)
+                {
+                    task(jobBegin, jobEnd);
+                });
+            }
+        }
+        Wait(executionContext);
+    }
+
+    FrameStatistics Scheduler::BeginFrame(Duration frameBudget)
+    {
+        const TimePoint frameDeadline = frameBudget > Duration::zero() ? std::chrono::steady_clock::now() + frameBudget : NoDeadline;
+        m_State->m_FrameDeadline.store(frameDeadline.time_since_epoch().count());
+        m_State->m_FrameIndex.fetch_add(1);
+
+        FrameStatistics frameStatistics;
+        frameStatistics.m_DeadlineJobCount = m_State->m_FrameDeadlineJobCount.exchange(0);
+        frameStatistics.m_DeadlineMissCount = m_State->m_FrameDeadlineMissCount.exchange(0);
+        const Duration worstLateness = Duration(m_State->m_FrameWorstLateness.exchange(0));
+        frameStatistics.m_WorstLatenessMilliseconds = std::chrono::duration<float, std::milli>(worstLateness).count();
+        return frameStatistics;
+    }
+
+    FrameStatistics BeginFrame(Duration frameBudget)
+    {
+        return GetDefaultScheduler().BeginFrame(frameBudget);
+    }
+
+    // Workers allocate from the arena of their own scheduler. Other threads allocate for the default scheduler.
+    void* FrameAlloc(size_t size, size_t alignment)
+    {
+        InternalState& state = t_WorkerScheduler != nullptr ? *t_WorkerScheduler : *GetDefaultScheduler().m_State;
+        FrameArena& frameArena = t_FrameArena;
+        const uint64_t frameIndex = state.m_FrameIndex.load(std::memory_order_acquire);
+        if (frameArena.m_SchedulerID != state.m_SchedulerID)
+        {
+            frameArena.m_Usage = std::make_shared<FrameArenaUsage>();
+            frameArena.m_Usage->m_ThreadID = state.GetCurrentThreadID();
+            frameArena.m_SchedulerID = state.m_SchedulerID;
+            frameArena.m_FrameIndex = frameIndex;
+            frameArena.m_Arena.Rewind({});
+
+            std::scoped_lock lock(state.m_FrameArenaLock);
+            state.m_FrameArenaUsages.push_back(frameArena.m_Usage);
+        }
+        else if (frameArena.m_FrameIndex != frameIndex)
+        {
+            frameArena.m_FrameIndex = frameIndex;
+            frameArena.m_Arena.Rewind({});
+            frameArena.m_Usage->m_UsedSize.store(0, std::memory_order_relaxed);
+        }
+
+        FrameArenaUsage& usage = *frameArena.m_Usage;
+        const size_t usedSize = usage.m_UsedSize.load(std::memory_order_relaxed) + size;
+        usage.m_UsedSize.store(usedSize, std::memory_order_relaxed);
+        if (usedSize > usage.m_PeakSize.load(std::memory_order_relaxed))
+        {
+            usage.m_PeakSize.store(usedSize, std::memory_order_relaxed);
+        }
+        return frameArena.m_Arena.Allocate(size, alignment);
+    }
+
+    std::vector<uint32_t> Scheduler::GetPoolCores(Priority priority) const
+    {
+        std::scoped_lock lock(m_State->m_CoreLock);
+        return m_State->m_PoolCores[int(priority)];
+    }
+
+    std::vector<uint32_t> GetPoolCores(Priority priority)
+    {
+        return GetDefaultScheduler().GetPoolCores(priority);
+    }
+
+    std::vector<uint32_t> Scheduler::GetStealOrder(Priority priority, uint32_t threadIndex) const
+    {
+        const PriorityResources& resource = m_State->m_Resources[int(priority)];
+        const uint32_t* stealOrder = resource.m_StealOrder.load(std::memory_order_acquire) + (threadIndex % resource.m_ThreadCount) * resource.m_ThreadCount;
+        return std::vector<uint32_t>(stealOrder, stealOrder + resource.m_ThreadCount);
+    }
+
+    std::vector<uint32_t> GetStealOrder(Priority priority, uint32_t threadIndex)
+    {
+        return GetDefaultScheduler().GetStealOrder(priority, threadIndex);
+    }
+
+    std::vector<FrameArenaStatistics> Scheduler::GetFrameArenaStatistics() const
+    {
+        std::vector<FrameArenaStatistics> frameArenaStatistics;
+        std::scoped_lock lock(m_State->m_FrameArenaLock);
+        for (const std::shared_ptr<FrameArenaUsage>& usage : m_State->m_FrameArenaUsages)
+        {
+            frameArenaStatistics.push_back({ usage->m_ThreadID, usage->m_UsedSize.load(std::memory_order_relaxed), usage->m_PeakSize.load(std::memory_order_relaxed) });
+        }
+        return frameArenaStatistics;
+    }
+
+    std::vector<FrameArenaStatistics> GetFrameArenaStatistics()
+    {
+        return GetDefaultScheduler().GetFrameArenaStatistics();
+    }
+
+    TimePoint Scheduler::GetFrameDeadline() const
+    {
+        return TimePoint(Duration(m_State->m_FrameDeadline.load()));
+    }
+
+    TimePoint GetFrameDeadline()
+    {
+        return GetDefaultScheduler().GetFrameDeadline();
+    }
+
+    void Scheduler::SetStarvationAgingWindow(Duration agingWindow)
+    {
+        m_State->m_AgingWindow.store(agingWindow.count());
+    }
+
+    void SetStarvationAgingWindow(Duration agingWindow)
+    {
+        GetDefaultScheduler().SetStarvationAgingWindow(agingWindow);
+    }
+
+    BlockingScope::BlockingScope()
+    {
+        if (t_WorkerScheduler == nullptr)
+        {
+            return;
+        }
+
+        m_Resource = &t_WorkerScheduler->m_Resources[int(t_WorkerPriority)];
+        PriorityResources& resource = *m_Resource;
+        const uint32_t spareIndex = resource.m_BlockedThreadCount.fetch_add(1);
+        if (spareIndex >= resource.m_SpareThreadCount)
+        {
+            return; // More workers blocked than there are spares. The rest go uncompensated.
+        }
+
+        resource.EnsureSpawned(resource.m_ThreadCount + spareIndex);
+        {
+            std::scoped_lock lock(resource.m_WakeMutex);
+        }
+        resource.m_ParkCondition.notify_all();
+    }
+
+    BlockingScope::~BlockingScope()
+    {
+        // The spare finishes the job it is on and parks itself, see PriorityResources::IsWorkerActive().
+        if (m_Resource != nullptr)
+        {
+            m_Resource->m_BlockedThreadCount.fetch_sub(1);
+        }
+    }
+
+    uint32_t Scheduler::GetActiveThreadCount(Priority priorityType) const
+    {
+        return m_State->m_Resources[int(priorityType)].GetActiveThreadCount();
+    }
+
+    uint32_t GetActiveThreadCount(Priority priorityType)
+    {
+        return GetDefaultScheduler().GetActiveThreadCount(priorityType);
+    }
+
+    // Simplified hill climbing: keep moving the active worker count one step in the same direction while throughput improves, and turn around when it drops.
+    // Changes within the noise threshold are treated as improvements, so the controller keeps probing rather than settling on a plateau edge.
+    // Samples are jobs, so one may still be running when the next is due, or become due after the controller was disabled. The lock keeps them apart, and
+    // disabling takes it too, so no sample changes the active count once the controller was disabled.
+    struct ThreadCountController
+    {
+        std::mutex m_SampleLock;
+        bool m_IsEnabled = true;
+        uint64_t m_LastCompletedJobCount = 0;
+        TimePoint m_LastSampleTime = std::chrono::steady_clock::now();
+        double m_LastThroughput = 0.0;
+        int m_Direction = -1; // Start by probing fewer threads. Oversubscription is the common case.
+
+        void Disable()
+        {
+            std::scoped_lock lock(m_SampleLock);
+            m_IsEnabled = false;
+        }
+
+        void Sample(PriorityResources& resource)
+        {
+            constexpr double noiseThreshold = 0.05;
+
+            std::unique_lock<std::mutex> lock(m_SampleLock, std::try_to_lock);
+            if (!lock.owns_lock() || !m_IsEnabled)
+            {
+                return;
+            }
+
+            // Samples queue behind the very backlog they measure, so they run late by varying amounts. Throughput is taken over the time that actually passed.
+            const TimePoint sampleTime = std::chrono::steady_clock::now();
+            const double elapsedSeconds = std::chrono::duration<double>(sampleTime - m_LastSampleTime).count();
+            if (elapsedSeconds <= 0.0)
+            {
+                return;
+            }
+
+            const uint64_t completedJobCount = resource.m_CompletedJobCount.load();
+            const double throughput = double(completedJobCount - m_LastCompletedJobCount) / elapsedSeconds;
+            m_LastCompletedJobCount = completedJobCount;
+            m_LastSampleTime = sampleTime;
+
+            // Throughput only reflects the thread count while there is a backlog. Otherwise it just reflects how much work was submitted.
+            if (resource.m_QueuedJobCount.load() == 0)
+            {
+                m_LastThroughput = 0.0;
+                return;
+            }
+
+            if (m_LastThroughput > 0.0 && throughput < m_LastThroughput * (1.0 - noiseThreshold))
+            {
+                m_Direction = -m_Direction;
+            }
+            m_LastThroughput = throughput;
+
+            // Probing beyond the budget would have no effect.
+            const uint32_t threadBudget = resource.m_ThreadBudget.load();
+            const uint32_t activeThreadCount = std::min(resource.m_ActiveThreadCount.load(), threadBudget);
+            if ((m_Direction < 0 && activeThreadCount == 1) || (m_Direction > 0 && activeThreadCount == threadBudget))
+            {
+                m_Direction = -m_Direction;
+            }
+
+            const uint32_t newActiveThreadCount = std::clamp<uint32_t>(activeThreadCount + m_Direction, 1u, threadBudget);
+            resource.m_ActiveThreadCount.store(newActiveThreadCount);
+            if (newActiveThreadCount > activeThreadCount)
+            {
+                std::scoped_lock lock(resource.m_WakeMutex);
+                resource.m_ParkCondition.notify_all();
+            }
+        }
+    };
+
+    void Scheduler::EnableThreadCountController(Priority priorityType, bool isEnabled, Duration samplingInterval)
+    {
+        PriorityResources& resource = m_State->m_Resources[int(priorityType)];
+        if (resource.m_Controller != nullptr)
+        {
+            CancelTimer(resource.m_ControllerTimerID);
+            resource.m_Controller->Disable(); // Samples already due may still run, but leave the active count alone from here on.
+            resource.m_ControllerTimerID = 0;
+            resource.m_Controller.reset();
+        }
+
+        if (isEnabled)
+        {
+            std::shared_ptr<ThreadCountController> controller = std::make_shared<ThreadCountController>();
+            controller->m_LastCompletedJobCount = resource.m_CompletedJobCount.load();
+            resource.m_Controller = controller;
+            resource.m_ControllerTimerID = ExecuteEvery(samplingInterval, [controller, &resource](JobArguments)
+            {
+                controller->Sample(resource);
+            });
+        }
+        else
+        {
+            std::scoped_lock lock(resource.m_WakeMutex);
+            resource.m_ActiveThreadCount.store(resource.m_ThreadCount);
+            resource.m_ParkCondition.notify_all();
+        }
+    }
+
+    void EnableThreadCountController(Priority priorityType, bool isEnabled, Duration samplingInterval)
+    {
+        GetDefaultScheduler().EnableThreadCountController(priorityType, isEnabled, samplingInterval);
+    }
+
+    // Re-pins and reschedules the high priority workers spawned so far. Returns whether all of them could be moved into the FIFO class, if asked to.
+    static bool ApplyRealTimeScheduling(PriorityResources& resource)
+    {
+        const int fifoPriority = resource.m_FIFOPriority.load();
+        bool isFIFOScheduled = true;
+        std::scoped_lock lock(resource.m_SpawnLock);
+        for (uint32_t threadID = 0; threadID < resource.GetWorkerCapacity(); threadID++)
+        {
+            if (resource.m_Threads[threadID].joinable())
+            {
+                const std::thread::native_handle_type threadHandle = resource.m_WorkerStates[threadID].m_ThreadHandle;
+                SetThreadAffinity(threadHandle, GetWorkerCore(resource, threadID));
+                SetOSThreadPriority(threadHandle, resource.m_PriorityType);
+                if (fifoPriority > 0)
+                {
+                    isFIFOScheduled = SetRealTimeThreadPriority(threadHandle, fifoPriority) && isFIFOScheduled;
+                }
+            }
+        }
+        return isFIFOScheduled;
+    }
+
+    RealTimeStatus Scheduler::EnableRealTimeMode(const RealTimeSettings& settings)
+    {
+        InternalState& state = *m_State;
+        PriorityResources& resource = state.m_Resources[int(Priority::High)];
+        std::scoped_lock lock(state.m_RealTimeLock);
+
+        std::vector<uint32_t> realTimeCores = settings.m_Cores;
+        std::sort(realTimeCores.begin(), realTimeCores.end());
+        realTimeCores.erase(std::unique(realTimeCores.begin(), realTimeCores.end()), realTimeCores.end());
+        assert(!realTimeCores.empty());
+
+        // Locked first, so the pages of the workers spawned below are locked as they are mapped.
+        RealTimeStatus status;
+        if (settings.m_LockMemory && !state.m_IsMemoryLocked)
+        {
+            state.m_IsMemoryLocked = LockProcessMemory();
+        }
+        status.m_IsMemoryLocked = state.m_IsMemoryLocked;
+
+        {
+            std::scoped_lock coreLock(state.m_CoreLock);
+            state.m_RealTimeCores = realTimeCores;
+        }
+
+        const float pollDuty = std::clamp(settings.m_MaxPollDuty, 0.0f, 1.0f);
+        const Duration pollTime = std::chrono::duration_cast<Duration>(settings.m_PollPeriod * pollDuty);
+        resource.m_PollTime.store(std::max(pollTime, Duration(1)).count());
+        resource.m_PollSleepTime.store((settings.m_PollPeriod - pollTime).count());
+        resource.m_FIFOPriority.store(settings.m_FIFOPriority);
+
+        // Without the privileges for it, workers spawned later don't try again.
+        resource.EnsureStarted();
+        status.m_IsFIFOScheduled = ApplyRealTimeScheduling(resource);
+        if (!status.m_IsFIFOScheduled)
+        {
+            resource.m_FIFOPriority.store(0);
+            ApplyRealTimeScheduling(resource);
+        }
+
+        UpdateCPUBudget(state);
+        {
+            std::scoped_lock wakeLock(resource.m_WakeMutex);
+            resource.m_WakeCondition.notify_all(); // Sleeping workers start polling.
+            resource.m_ParkCondition.notify_all();
+        }
+        return status;
+    }
+
+    void Scheduler::DisableRealTimeMode()
+    {
+        InternalState& state = *m_State;
+        PriorityResources& resource = state.m_Resources[int(Priority::High)];
+        std::scoped_lock lock(state.m_RealTimeLock);
+
+        {
+            std::scoped_lock coreLock(state.m_CoreLock);
+            state.m_RealTimeCores.clear();
+        }
+        resource.m_PollTime.store(0);
+        resource.m_PollSleepTime.store(0);
+        resource.m_FIFOPriority.store(0);
+        ApplyRealTimeScheduling(resource);
+        UpdateCPUBudget(state);
+
+        if (state.m_IsMemoryLocked)
+        {
+            UnlockProcessMemory();
+            state.m_IsMemoryLocked = false;
+        }
+    }
+
+    bool Scheduler::EnableJobServer(bool isEnabled)
+    {
+        InternalState& state = *m_State;
+        std::scoped_lock lock(state.m_JobServerLock);
+        if (isEnabled && !state.m_JobServer.IsConnected() && !state.m_JobServer.Connect(getenv("MAKEFLAGS")))
+        {
+            return false;
+        }
+
+        state.m_IsJobServerEnabled.store(isEnabled);
+        return true;
+    }
+
+    bool EnableJobServer(bool isEnabled)
+    {
+        return GetDefaultScheduler().EnableJobServer(isEnabled);
+    }
+
+    RealTimeStatus EnableRealTimeMode(const RealTimeSettings& settings)
+    {
+        return GetDefaultScheduler().EnableRealTimeMode(settings);
+    }
+
+    void DisableRealTimeMode()
+    {
+        GetDefaultScheduler().DisableRealTimeMode();
+    }
+
+    void Scheduler::SetQueueLimits(Priority priority, uint32_t perThreadCapacity, uint32_t totalCapacity, BackpressurePolicy policy)
+    {
+        PriorityResources& resource = m_State->m_Resources[int(priority)];
+        for (uint32_t i = 0; i < resource.m_ThreadCount; i++)
+        {
+            std::scoped_lock lock(resource.m_JobQueuesPerThread[i].m_QueueLock);
+            resource.m_JobQueuesPerThread[i].m_Capacity = perThreadCapacity;
+        }
+        resource.m_TotalCapacity.store(totalCapacity);
+        resource.m_BackpressurePolicy.store(policy);
+    }
+
+    void SetQueueLimits(Priority priority, uint32_t perThreadCapacity, uint32_t totalCapacity, BackpressurePolicy policy)
+    {
+        GetDefaultScheduler().SetQueueLimits(priority, perThreadCapacity, totalCapacity, policy);
+    }
+
+    uint32_t Scheduler::GetQueueDepth(Priority priority) const
+    {
+        return m_State->m_Resources[int(priority)].m_QueuedJobCount.load();
+    }
+
+    uint32_t GetQueueDepth(Priority priority)
+    {
+        return GetDefaultScheduler().GetQueueDepth(priority);
+    }
+
+    void Scheduler::SetJobCoalescing(bool isEnabled)
+    {
+        m_State->m_IsCoalescingEnabled.store(isEnabled);
+    }
+
+    void SetJobCoalescing(bool isEnabled)
+    {
+        GetDefaultScheduler().SetJobCoalescing(isEnabled);
     }
 }
\ No newline at end of file
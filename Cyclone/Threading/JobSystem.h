@@ -4,12 +4,32 @@
 #include <functional>
 #include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 // The engine does not know about the concept of Jobs. It simply is concerned with adding tasks that need to be executed in parallel.
 namespace Cyclone
 {
+    using TimePoint = std::chrono::steady_clock::time_point;
+    using Duration = std::chrono::steady_clock::duration;
+    using TimerID = uint64_t;
+    using ThreadID = uint32_t;
+
+    constexpr ThreadID InvalidThreadID = ~0u;
+
+    // Jobs carrying this deadline are not time critical and are aged instead (see SetStarvationAgingWindow()).
+    constexpr TimePoint NoDeadline = TimePoint::max();
+
+    constexpr size_t DefaultSharedMemoryAlignment = alignof(std::max_align_t);
+
     struct JobArguments
     {
         uint32_t m_JobIndex; // Relative to a dispatch.
@@ -19,7 +39,8 @@ namespace Cyclone
         bool m_IsFirstJobInGroup; 
         bool m_IsLastJobInGroup;
 
-        void* m_SharedMemory; // Stack memory within its group (which is executed serially), allowing for data to be shared.
+        void* m_SharedMemory; // Memory shared by the jobs of the group (which execute serially), as requested from Dispatch(). Valid until the last job of the group returns.
+        uint32_t m_SharedMemorySize;
     };
 
     enum class Priority
@@ -30,33 +51,430 @@ namespace Cyclone
         Count
     };
 
+    // Which logical cores a scheduler places its workers on.
+    enum class CorePlacement
+    {
+        PhysicalCores,  // Default. One worker per physical core, so workers don't compete with each other for the execution units of an SMT core.
+        LogicalCores    // One worker per logical core, SMT siblings included.
+    };
+
+    // Limits how many jobs of this class may execute at once, such as jobs hitting the disk or touching the audio mixer.
+    // Jobs over the limit are held back and requeued as running ones complete, so workers move on to other work instead of blocking.
+    // Must outlive every context whose jobs use it, until those have been waited on.
+    struct JobClass
+    {
+        explicit JobClass(uint32_t maxConcurrency);
+        ~JobClass();
+
+        const uint32_t m_MaxConcurrency;
+        std::atomic<uint32_t> m_RunningCount = 0;
+        std::atomic<uint32_t> m_HeldCount = 0;
+        std::unique_ptr<struct HeldJobs> m_HeldJobs; // Jobs that were picked up while the class was at its limit.
+    };
+
+    // What a submitting thread does when the queues of a priority are full. See SetQueueLimits().
+    enum class BackpressurePolicy
+    {
+        Help,           // Default. The submitter executes queued jobs until there is room for its own.
+        FailFast        // The submission is rejected with SubmitStatus::QueueFull.
+    };
+
+    enum class SubmitStatus
+    {
+        Submitted,
+        QueueFull,
+        UnknownThread,  // ExecuteOn() targeted a thread that is neither a worker nor registered with the scheduler of the context.
+        NotStarted,     // TryExecute() targeted a priority whose workers haven't been spawned yet.
+        InvalidArgument // Dispatch() was asked for more shared memory, or a stronger alignment, than JobArguments can describe.
+    };
+
+    // Returned by resumable tasks to tell whether they have more work to do.
+    enum class JobStatus
+    {
+        Continue,
+        Done
+    };
+
+    struct Scheduler;
+
     // Defines a state of execution. This can consists of multiple jobs which can be waited on.
     struct Context
     {
         std::atomic<uint32_t> m_JobCounter = 0;
         Priority m_Priority = Priority::High;
+        JobClass* m_JobClass = nullptr; // Optional concurrency limit shared by all jobs of this context.
+        TimePoint m_Deadline = NoDeadline; // Point in time by which jobs of this context should have completed. Each worker queue hands out its ready jobs earliest deadline first, so across queues the order is only approximate.
+        Scheduler* m_Scheduler = nullptr;  // Scheduler executing the jobs of this context. The default scheduler if null.
+        Duration m_CostHint = Duration::zero(); // Expected execution time of a single job. Only jobs hinted to be tiny are executed inline or coalesced. Zero if unknown.
+    };
+
+    // Jobs executed through the same strand run one at a time and in submission order, on whichever worker is free. No thread ever blocks on a strand.
+    // Useful for state owned by a single entity or connection. The strand must outlive its jobs, so Wait() on its context before destroying it.
+    struct Strand
+    {
+        explicit Strand(Context& executionContext);
+        ~Strand();
+
+        Context& m_Context;
+        std::unique_ptr<struct StrandQueue> m_Queue; // Lock-free queue of jobs not yet executed.
+        std::atomic<uint32_t> m_PendingCount = 0;    // Jobs submitted but not yet completed. Whoever raises this from zero schedules the strand.
     };
 
-    void Initialize(uint32_t maxThreadCount = ~0u);
+    // Deadline bookkeeping gathered between two frame boundaries.
+    struct FrameStatistics
+    {
+        uint32_t m_DeadlineJobCount = 0;        // Jobs with a deadline that completed during the frame.
+        uint32_t m_DeadlineMissCount = 0;       // Of those, jobs that completed after their deadline.
+        float m_WorstLatenessMilliseconds = 0;  // How late the latest of the missed jobs was.
+    };
+
+    // Usage of the FrameAlloc() arena of one thread, in bytes requested.
+    struct FrameArenaStatistics
+    {
+        ThreadID m_ThreadID = InvalidThreadID;  // Owning worker or registered thread. InvalidThreadID for threads that are neither.
+        size_t m_UsedSize = 0;                  // In the last frame the thread allocated in.
+        size_t m_PeakSize = 0;                  // Most used in a single frame so far.
+    };
+
+    // Real-time mode, for deployments after the lowest wake to execute latency. See EnableRealTimeMode().
+    struct RealTimeSettings
+    {
+        std::vector<uint32_t> m_Cores;                          // Isolated logical cores for the high priority workers. One worker is kept active per core.
+        int m_FIFOPriority = 50;                                // SCHED_FIFO priority of the workers, from 1 to 99.
+        float m_MaxPollDuty = 0.95f;                            // Share of each poll period that idle workers spend polling, sleeping for the rest. 1 never sleeps.
+        Duration m_PollPeriod = std::chrono::milliseconds(1);   // The default duty matches the share of CPU time Linux grants real-time threads by default.
+        bool m_LockMemory = true;                               // Locks all current and future pages of the process into memory, so no page fault stalls a worker.
+    };
+
+    // What EnableRealTimeMode() managed to put in place. Workers are pinned and poll regardless.
+    struct RealTimeStatus
+    {
+        bool m_IsFIFOScheduled = false; // Requires CAP_SYS_NICE or a sufficient RLIMIT_RTPRIO.
+        bool m_IsMemoryLocked = false;  // Requires CAP_IPC_LOCK or a sufficient RLIMIT_MEMLOCK.
+    };
+
+    // Wraps a blocking call made from inside a job, such as a file read or waiting on a socket. While the scope is alive, a spare worker of the same priority
+    // stands in for the blocked one so the pool keeps its concurrency, and is parked again once the scope ends. Has no effect on threads that aren't workers.
+    struct BlockingScope
+    {
+        BlockingScope();
+        ~BlockingScope();
+        BlockingScope(const BlockingScope&) = delete;
+        BlockingScope& operator=(const BlockingScope&) = delete;
+
+        struct PriorityResources* m_Resource = nullptr; // Pool of the blocked worker, or null if the scope was entered off the workers.
+    };
+
+    // An independent job system with its own worker pools, cores and policies, such as one isolating latency critical simulation from batch processing
+    // in the same process. Contexts are bound to a scheduler through Context::m_Scheduler. The free functions below act on the default scheduler.
+    // Jobs can hand work to another scheduler by submitting to one of its contexts. Such submissions go through its lock-free injection queues, and are
+    // never executed inline by the submitting worker.
+    struct Scheduler
+    {
+        // Cores        - Logical cores the workers may be placed on, any of them if empty. Pools are sized after the number of cores listed.
+        // Placement    - Whether SMT siblings count as cores of their own.
+        explicit Scheduler(uint32_t maxThreadCount = ~0u, const std::vector<uint32_t>& cores = {}, CorePlacement placement = CorePlacement::PhysicalCores);
+        ~Scheduler();
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        // As the free functions of the same name, for this scheduler. Timer and thread IDs are only meaningful to the scheduler that handed them out.
+        // A thread can be registered with one scheduler at a time.
+        uint32_t GetThreadCount(Priority priority = Priority::High) const;
+        uint32_t GetActiveThreadCount(Priority priority = Priority::High) const;
+        void EnableThreadCountController(Priority priority, bool isEnabled, Duration samplingInterval = std::chrono::milliseconds(100));
+        RealTimeStatus EnableRealTimeMode(const RealTimeSettings& settings);
+        void DisableRealTimeMode();
+        bool EnableJobServer(bool isEnabled);
+        void SetQueueLimits(Priority priority, uint32_t perThreadCapacity, uint32_t totalCapacity, BackpressurePolicy policy = BackpressurePolicy::Help);
+        void SetJobCoalescing(bool isEnabled);
+        uint32_t GetQueueDepth(Priority priority = Priority::High) const;
+        TimerID ExecuteEvery(Duration period, const std::function<void(JobArguments)>& task);
+        void CancelTimer(TimerID timerID);
+        ThreadID RegisterThread();
+        ThreadID GetCurrentThreadID() const;
+        ThreadID GetWorkerThreadID(Priority priority, uint32_t threadIndex) const;
+        std::vector<uint32_t> GetPoolCores(Priority priority) const;
+        std::vector<uint32_t> GetStealOrder(Priority priority, uint32_t threadIndex) const;
+        uint32_t RunPending();
+        FrameStatistics BeginFrame(Duration frameBudget = Duration::zero());
+        TimePoint GetFrameDeadline() const;
+        std::vector<FrameArenaStatistics> GetFrameArenaStatistics() const;
+        void SetStarvationAgingWindow(Duration agingWindow);
+
+        std::unique_ptr<struct InternalState> m_State;
+    };
+
+    // Workers are spawned lazily, the first time a priority is given work, so unused priorities cost no threads.
+    // Initialize() and Shutdown() create and destroy the default scheduler.
+    void Initialize(uint32_t maxThreadCount = ~0u, CorePlacement placement = CorePlacement::PhysicalCores);
     void Shutdown();
 
+    // The scheduler of contexts without one of their own.
+    Scheduler& GetDefaultScheduler();
+
+    // Schedulers lay out their workers after the CPU topology read from sysfs, such that workers steal from those sharing a core, an L3 and a NUMA node
+    // before crossing further. The root defaults to /sys/devices/system, and can be pointed at a fake tree for testing. Only affects schedulers created afterwards.
+    // A fake tree describes cores other than those of this machine, so schedulers created on one ignore the affinity of the process.
+    void SetTopologyRoot(const std::string& sysfsRoot);
+
+    // Cores set aside for the workers of the priority, as laid out after the topology and the cores granted to the process.
+    std::vector<uint32_t> GetPoolCores(Priority priority);
+
+    // Indices of the workers of the priority whose queues the given worker steals from, in the order it tries them. Starts with its own.
+    std::vector<uint32_t> GetStealOrder(Priority priority, uint32_t threadIndex);
+
     uint32_t GetThreadCount(Priority priority = Priority::High);
+
+    // Number of workers of the priority currently allowed to execute jobs. Lower than GetThreadCount() while the thread count controller parks some.
+    uint32_t GetActiveThreadCount(Priority priority = Priority::High);
+
+    // Enables a controller which samples the job throughput of the priority every interval and hill climbs towards the number of active workers completing
+    // the most jobs, parking the rest. Fewer threads often finish memory bound work sooner. Disabling it reactivates every worker.
+    void EnableThreadCountController(Priority priority, bool isEnabled, Duration samplingInterval = std::chrono::milliseconds(100));
+
+    // Moves the high priority workers onto isolated cores (isolcpus, nohz_full) under SCHED_FIFO, with the memory of the process locked and their stacks pre-faulted.
+    // Idle workers busy-poll for work instead of sleeping on a condition variable, cutting wake to execute latency from tens of microseconds to below one.
+    // Parts needing privileges the process lacks are left out, as reported by the returned status. Workers are spawned right away, so they are in place before
+    // the first job arrives.
+    RealTimeStatus EnableRealTimeMode(const RealTimeSettings& settings);
+
+    // Returns the high priority workers to their regular cores and scheduling, and unlocks memory locked by EnableRealTimeMode().
+    void DisableRealTimeMode();
+
+    // Opt-in. Has workers take a token from the GNU make jobserver the process was started under before executing queued jobs, and hand it back once
+    // out of work, so that tools running side by side in a build share the cores rather than each using all of them. The process keeps its one implicit
+    // slot for the threads calling Wait(), which never take tokens. Returns false if no jobserver was found in MAKEFLAGS.
+    bool EnableJobServer(bool isEnabled);
     
+    // Bounds the queues of a priority. A capacity of zero leaves that bound out. Both are unbounded by default.
+    // PerThreadCapacity    - Maximum number of jobs queued for any one worker.
+    // TotalCapacity        - Maximum number of jobs queued across all workers of the priority.
+    // Policy               - What Execute() and Dispatch() do once the queues are full.
+    void SetQueueLimits(Priority priority, uint32_t perThreadCapacity, uint32_t totalCapacity, BackpressurePolicy policy = BackpressurePolicy::Help);
+
+    // Enables or disables the coalescing of tiny jobs in Execute(). Enabled by default. Only contexts hinted to hold tiny jobs are coalesced. See Context::m_CostHint.
+    void SetJobCoalescing(bool isEnabled);
+
+    // Number of jobs queued for the priority that haven't been picked up yet. Useful for shedding load before the queues fill up.
+    uint32_t GetQueueDepth(Priority priority = Priority::High);
+
     // Adds a task to execute asynchronously. Any idle thread can execute this.
-    void Execute(Context& executionContext, const std::function<void(JobArguments)>& task);
+    // The task is moved through the queues rather than copied, so the only allocation is that of the std::function itself, if its callable doesn't fit in place.
+    // While the queues are backed up, consecutive calls from the same thread on the same tiny context with the same kind of callable are coalesced into a single job,
+    // as long as it hasn't been picked up yet. This cuts the per job overhead of tiny tasks. See SetJobCoalescing().
+    // Workers submitting to a saturated pool of their own priority or below execute tiny jobs in line instead. See Context::m_CostHint.
+    SubmitStatus Execute(Context& executionContext, std::function<void(JobArguments)> task);
+
+    // As above, but the job carries its own deadline instead of the one of its context.
+    SubmitStatus Execute(Context& executionContext, std::function<void(JobArguments)> task, TimePoint deadline);
+
+    // Entry point for real-time threads, such as audio callbacks. Only ever tries the lock-free injection queue of the priority once. It never falls back to
+    // the per thread queues and their locks, never executes the task in line or helps with other work, and neither allocates nor spawns workers. If the
+    // injection queue or the queue limits are full, fails with SubmitStatus::QueueFull. Workers of the priority must have been started beforehand, by
+    // any regular submission, or it fails with SubmitStatus::NotStarted. The task is only moved from if submitted. Jobs are executed in submission order,
+    // regardless of the deadline of the context, and are never coalesced.
+    SubmitStatus TryExecute(Context& executionContext, std::function<void(JobArguments)>&& task);
+
+    // Adds many independent tasks at once. Cheaper than calling Execute() for each of them, as the context, queue capacity and wake ups are dealt with once for the
+    // whole batch, and the jobs are distributed over the worker queues in bulk. Under BackpressurePolicy::FailFast, the batch is admitted whole or not at all.
+    // The tasks are copied, and the staging array of batches beyond a few dozen tasks is larger than SizeClassAlloc() serves, so those touch the global heap.
+    SubmitStatus SubmitBatch(Context& executionContext, const std::function<void(JobArguments)>* tasks, uint32_t taskCount);
+
+    // Adds a task to the strand. It will execute after all tasks previously added to the strand have completed.
+    void Execute(Strand& strand, std::function<void(JobArguments)> task);
+
+    // Executes a long running task cooperatively. The task is invoked repeatedly, each call doing a bounded step of work, until it returns JobStatus::Done.
+    // Once a job has run for longer than its time slice, it is requeued behind other work, keeping the latency of the rest of the queue bounded.
+    void ExecuteResumable(Context& executionContext, const std::function<JobStatus(JobArguments)>& task, Duration timeSlice = std::chrono::milliseconds(1));
+
+    // Executes the task on the context once the delay has elapsed. The job counts towards the context immediately, so Wait() also waits for the delay.
+    void ExecuteAfter(Context& executionContext, Duration delay, std::function<void(JobArguments)> task);
+
+    // Executes the task on the context once every period, until cancelled. Each execution only counts towards the context once it is due.
+    TimerID ExecuteEvery(Context& executionContext, Duration period, const std::function<void(JobArguments)>& task);
+
+    // As above, on an internal high priority context.
+    TimerID ExecuteEvery(Duration period, const std::function<void(JobArguments)>& task);
+
+    // Stops a periodic task from being executed again. Executions already due may still run.
+    void CancelTimer(TimerID timerID);
+
+    // Registers the calling thread, such as the main or render thread, so jobs can be pinned to it with ExecuteOn(). Returns its existing ID if already registered.
+    // Jobs pinned to a registered thread only execute when it calls Wait() or RunPending().
+    ThreadID RegisterThread();
+
+    // ID of the calling thread, or InvalidThreadID if it is neither a worker nor registered.
+    ThreadID GetCurrentThreadID();
+
+    // ID of a specific worker thread, for pinning jobs to it.
+    ThreadID GetWorkerThreadID(Priority priority, uint32_t threadIndex);
+
+    // Adds a task that may only execute on the given thread. Workers execute pinned jobs in between their other jobs.
+    // Pinned jobs are not subject to the job class of their context. Fails with SubmitStatus::UnknownThread for IDs the scheduler didn't hand out.
+    SubmitStatus ExecuteOn(ThreadID threadID, Context& executionContext, std::function<void(JobArguments)> task);
+
+    // Executes all jobs currently pinned to the calling thread. Returns how many were executed.
+    uint32_t RunPending();
 
     // Divides a task into multiple jobs and executes them in parallel.
     // JobCount     - How many jobs to generate for this task.
     // GroupSize    - How many jobs to execute per thread. Jobs inside a group execute serially. 
     // Task         - The task at hand. Receive a JobArguments parameter defining the tasks themselves.
-    void Dispatch(Context& executionContext, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArguments)>& task, size_t sharedMemorySize = 0);
+    // SharedMemorySize      - Bytes of JobArguments::m_SharedMemory given to each group. Taken from a per thread arena when the group starts, and returned when it ends.
+    // SharedMemoryAlignment - Power of two the shared memory is aligned to. Anything else is rounded up to the next power of two.
+    // IsSharedMemoryZeroed  - Whether the shared memory is zeroed before the first job of the group, rather than left uninitialized.
+    // Under BackpressurePolicy::FailFast, the dispatch is admitted whole or not at all, against both the total and the per thread capacities of its priority.
+    // Sizes and alignments beyond 32 bits fail with SubmitStatus::InvalidArgument.
+    SubmitStatus Dispatch(Context& executionContext, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArguments)>& task, size_t sharedMemorySize = 0,
+                          size_t sharedMemoryAlignment = DefaultSharedMemoryAlignment, bool isSharedMemoryZeroed = false);
+
+    // Group reductions, for dispatches with at least sizeof(T) bytes of shared memory, at the default alignment or above. Each job folds its value into the partial result of its group,
+    // kept in shared memory without any synchronization as the jobs of a group execute serially. The last job of the group then hands the partial result on once,
+    // so combining the results costs one step per group rather than per job.
+
+    // Folds the partial result of the group into the total, which may be shared by all groups.
+    template<typename T, typename Combine>
+    void ReduceInGroup(const JobArguments& arguments, const T& value, std::atomic<T>& total, Combine combine)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "Partial results are never destroyed.");
+        static_assert(alignof(T) <= DefaultSharedMemoryAlignment, "Shared memory is only guaranteed to be aligned to DefaultSharedMemoryAlignment.");
+        assert(arguments.m_SharedMemory != nullptr && arguments.m_SharedMemorySize >= sizeof(T) && "Dispatch() must be given sizeof(T) bytes of shared memory.");
+        T& partialResult = arguments.m_IsFirstJobInGroup ? *new (arguments.m_SharedMemory) T(value) : *static_cast<T*>(arguments.m_SharedMemory);
+        if (!arguments.m_IsFirstJobInGroup)
+        {
+            partialResult = combine(partialResult, value);
+        }
+        if (arguments.m_IsLastJobInGroup)
+        {
+            T currentTotal = total.load(std::memory_order_relaxed);
+            while (!total.compare_exchange_weak(currentTotal, combine(currentTotal, partialResult)))
+            {
+            }
+        }
+    }
+
+    // Stores the partial result of the group at groupResults[m_GroupID], to be combined after the dispatch completes. Unlike the above, the order in which
+    // results are combined doesn't depend on scheduling, which keeps floating point reductions deterministic.
+    template<typename T, typename Combine>
+    void ReduceInGroup(const JobArguments& arguments, const T& value, T* groupResults, Combine combine)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "Partial results are never destroyed.");
+        static_assert(alignof(T) <= DefaultSharedMemoryAlignment, "Shared memory is only guaranteed to be aligned to DefaultSharedMemoryAlignment.");
+        assert(arguments.m_SharedMemory != nullptr && arguments.m_SharedMemorySize >= sizeof(T) && "Dispatch() must be given sizeof(T) bytes of shared memory.");
+        T& partialResult = arguments.m_IsFirstJobInGroup ? *new (arguments.m_SharedMemory) T(value) : *static_cast<T*>(arguments.m_SharedMemory);
+        if (!arguments.m_IsFirstJobInGroup)
+        {
+            partialResult = combine(partialResult, value);
+        }
+        if (arguments.m_IsLastJobInGroup)
+        {
+            groupResults[arguments.m_GroupID] = partialResult;
+        }
+    }
 
     // Returns the number of job groups that will be created for a set number of jobs and a group size.
     uint32_t GetDispatchGroupCount(uint32_t jobCount, uint32_t groupSize);
 
+    // Executes the task once on every worker of the context's priority, with the range of jobs that a Dispatch() of the same job count and group size
+    // places on the queue of that worker. Dispatch() always splits groups into the same contiguous runs, so memory first written by the task lands on
+    // the NUMA node of the worker that later processes it. Waits for the context to complete.
+    void FirstTouch(Context& executionContext, uint32_t jobCount, uint32_t groupSize, const std::function<void(uint32_t jobBegin, uint32_t jobEnd)>& task);
+
+    // Allocates memory aligned to and backed by transparent huge pages where the OS provides them, cutting TLB misses over large arrays.
+    // Pages are left untouched, to be placed by their first write. Free with FreeLargePages(), passing the same size.
+    void* AllocateLargePages(size_t size);
+    void FreeLargePages(void* memory, size_t size);
+
+    // Value-initializes the elements with the partitioning of a later Dispatch() of the same count and group size. See FirstTouch().
+    template<typename T>
+    void ParallelConstruct(Context& executionContext, T* data, uint32_t count, uint32_t groupSize)
+    {
+        FirstTouch(executionContext, count, groupSize, [data](uint32_t jobBegin, uint32_t jobEnd)
+        {
+            for (uint32_t i = jobBegin; i < jobEnd; i++)
+            {
+                new (&data[i]) T();
+            }
+        });
+    }
+
+    // An array to be processed by Dispatch() on the default scheduler, backed by huge pages and constructed in parallel such that each page sits on
+    // the NUMA node of the worker that processes it. Release with ParallelFree().
+    template<typename T>
+    T* ParallelAllocate(uint32_t count, uint32_t groupSize = 1, Priority priority = Priority::High)
+    {
+        static_assert(alignof(T) <= 4096, "Large pages are only guaranteed to be page aligned.");
+        T* data = static_cast<T*>(AllocateLargePages(sizeof(T) * count));
+        if (data != nullptr)
+        {
+            Context constructionContext;
+            constructionContext.m_Priority = priority;
+            ParallelConstruct(constructionContext, data, count, groupSize);
+        }
+        return data;
+    }
+
+    template<typename T>
+    void ParallelFree(T* data, uint32_t count)
+    {
+        if (data == nullptr)
+        {
+            return;
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            data[i].~T();
+        }
+        FreeLargePages(data, sizeof(T) * count);
+    }
+
     // Checks if any threads in the context are currently working on jobs.
     bool IsBusy(const Context& executionContext);
 
     // Wait until all threads become idle. The current thread will become a worker thread and assist in executing jobs. 
     void Wait(const Context& executionContext);
+
+    // Marks a frame boundary. The frame budget is used to compute GetFrameDeadline() for the new frame.
+    // Returns the deadline statistics of the frame that just ended.
+    FrameStatistics BeginFrame(Duration frameBudget = Duration::zero());
+
+    // Deadline of the current frame, as started by BeginFrame(). Assign it to Context::m_Deadline for frame critical work.
+    TimePoint GetFrameDeadline();
+
+    // Scratch memory for the current frame, such as culling lists and temporary matrices, from a linear arena owned by the calling thread. Allocating takes no lock
+    // and there is nothing to free: the memory is reclaimed once the next BeginFrame() is called. Workers allocate from the arenas of their scheduler, and other
+    // threads from those of the default scheduler. Without calls to BeginFrame(), the arenas keep growing.
+    void* FrameAlloc(size_t size, size_t alignment = DefaultSharedMemoryAlignment);
+
+    // Frame arena usage of every thread that called FrameAlloc(), for sizing budgets and spotting workers that allocate far more than others.
+    std::vector<FrameArenaStatistics> GetFrameArenaStatistics();
+
+    // Memory for objects that outlive a frame and are often freed by another thread than the one that created them, such as per job state.
+    // Sizes up to 4KB come from a cache owned by the calling thread, without taking a lock. Larger ones go to the global heap. Free with the same size.
+    void* SizeClassAlloc(size_t size);
+    void SizeClassFree(void* memory, size_t size);
+
+    // Standard allocator over SizeClassAlloc(), for containers and std::allocate_shared().
+    template<typename T>
+    struct SizeClassAllocator
+    {
+        using value_type = T;
+
+        SizeClassAllocator() = default;
+        template<typename U>
+        SizeClassAllocator(const SizeClassAllocator<U>&) { }
+
+        T* allocate(size_t count) { return static_cast<T*>(SizeClassAlloc(sizeof(T) * count)); }
+        void deallocate(T* memory, size_t count) { SizeClassFree(memory, sizeof(T) * count); }
+
+        template<typename U>
+        bool operator==(const SizeClassAllocator<U>&) const { return true; }
+        template<typename U>
+        bool operator!=(const SizeClassAllocator<U>&) const { return false; }
+    };
+
+    // Jobs without a deadline are treated as if they were due this long after their submission, so they can't be starved by deadline work.
+    void SetStarvationAgingWindow(Duration agingWindow);
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "LinearArena.h"
+
+#include <assert.h>
+
+namespace Cyclone
+{
+    static void* TryAllocateFromBlock(const LinearArena::Block& block, size_t& offset, size_t size, size_t alignment)
+    {
+        const uintptr_t blockBegin = reinterpret_cast<uintptr_t>(block.m_Memory.get());
+        const size_t alignedOffset = ((blockBegin + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - blockBegin;
+        if (alignedOffset > block.m_Size || size > block.m_Size - alignedOffset)
+        {
+            return nullptr;
+        }
+
+        offset = alignedOffset + size;
+        return block.m_Memory.get() + alignedOffset;
+    }
+
+    void* LinearArena::Allocate(size_t size, size_t alignment)
+    {
+        // The alignment comes straight from Dispatch() and FrameAlloc() callers. Masking with anything but a power of two would hand out overlapping memory.
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        {
+            size_t powerOfTwo = 1;
+            while (powerOfTwo < alignment)
+            {
+                powerOfTwo <<= 1;
+            }
+            alignment = powerOfTwo;
+        }
+
+        if (m_BlockIndex < m_Blocks.size())
+        {
+            if (void* memory = TryAllocateFromBlock(m_Blocks[m_BlockIndex], m_Offset, size, alignment))
+            {
+                return memory;
+            }
+            m_BlockIndex++;
+            m_Offset = 0;
+        }
+
+        // Blocks past the current one hold nothing, so one too small for the allocation can be replaced.
+        const size_t requiredSize = size + alignment - 1;
+        if (m_BlockIndex == m_Blocks.size())
+        {
+            m_Blocks.emplace_back();
+        }
+        Block& block = m_Blocks[m_BlockIndex];
+        if (block.m_Size < requiredSize)
+        {
+            block.m_Size = std::max(m_BlockSize, requiredSize);
+            block.m_Memory.reset(new uint8_t[block.m_Size]);
+        }
+        return TryAllocateFromBlock(block, m_Offset, size, alignment);
+    }
+
+    void LinearArena::Rewind(const Marker& marker)
+    {
+        assert(marker.m_BlockIndex < m_BlockIndex || (marker.m_BlockIndex == m_BlockIndex && marker.m_Offset <= m_Offset));
+        m_BlockIndex = marker.m_BlockIndex;
+        m_Offset = marker.m_Offset;
+    }
+}
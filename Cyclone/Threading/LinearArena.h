@@ -0,0 +1,37 @@
+#pragma once
+#include "JobSystem.h"
+
+#include <vector>
+
+namespace Cyclone
+{
+    // Bump allocator over a list of blocks, owned by a single thread. Rewinding to a marker frees everything allocated since, in LIFO order,
+    // which suits scopes that nest, such as a job group executing another group while it waits. Blocks are never resized, so allocations don't move,
+    // and are kept when rewound, so steady state use allocates nothing.
+    struct LinearArena
+    {
+        struct Marker
+        {
+            uint32_t m_BlockIndex = 0;
+            size_t m_Offset = 0;
+        };
+
+        struct Block
+        {
+            std::unique_ptr<uint8_t[]> m_Memory;
+            size_t m_Size = 0;
+        };
+
+        explicit LinearArena(size_t blockSize = 64 * 1024) : m_BlockSize(blockSize) { }
+
+        // Alignments that aren't a power of two, zero included, are rounded up to the next one.
+        void* Allocate(size_t size, size_t alignment);
+        Marker GetMarker() const { return { m_BlockIndex, m_Offset }; }
+        void Rewind(const Marker& marker);
+
+        std::vector<Block> m_Blocks;
+        uint32_t m_BlockIndex = 0; // Block allocations are currently made from. Those after it are unused.
+        size_t m_Offset = 0;       // Into the current block.
+        size_t m_BlockSize;        // Of new blocks, unless an allocation needs a larger one.
+    };
+}
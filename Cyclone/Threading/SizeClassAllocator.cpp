@@ -0,0 +1,230 @@
+#include "SizeClassAllocator.h"
+
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace Cyclone
+{
+    // Caches outlive their threads, as blocks they own may still be freed by others later on. The cache of an exited thread is handed on to the next thread
+    // that starts allocating, free lists and all. Neither caches nor spans are ever returned to the heap, so steady state use never takes its lock.
+    static std::mutex g_SizeClassCacheLock;
+    static std::vector<SizeClassCache*> g_UnownedSizeClassCaches;
+
+    static SizeClassCache* AcquireSizeClassCache()
+    {
+        {
+            std::scoped_lock lock(g_SizeClassCacheLock);
+            if (!g_UnownedSizeClassCaches.empty())
+            {
+                SizeClassCache* cache = g_UnownedSizeClassCaches.back();
+                g_UnownedSizeClassCaches.pop_back();
+                return cache;
+            }
+        }
+        return new SizeClassCache();
+    }
+
+    static void ReleaseSizeClassCache(SizeClassCache* cache)
+    {
+        cache->FlushRemoteFreeBatch();
+        std::scoped_lock lock(g_SizeClassCacheLock);
+        g_UnownedSizeClassCaches.push_back(cache);
+    }
+
+    // Releases the cache of the thread on exit. Other thread locals may still free blocks after this is destroyed, so the cache pointer is kept apart from it.
+    struct SizeClassCacheHolder
+    {
+        SizeClassCache* m_Cache = nullptr;
+
+        ~SizeClassCacheHolder();
+    };
+
+    thread_local SizeClassCache* t_SizeClassCache = nullptr;
+    thread_local bool t_IsSizeClassCacheReleased = false;
+    thread_local SizeClassCacheHolder t_SizeClassCacheHolder;
+
+    SizeClassCacheHolder::~SizeClassCacheHolder()
+    {
+        if (m_Cache != nullptr)
+        {
+            ReleaseSizeClassCache(m_Cache);
+        }
+        t_SizeClassCache = nullptr;
+        t_IsSizeClassCacheReleased = true;
+    }
+
+    // Null once the thread is exiting.
+    static SizeClassCache* GetSizeClassCache()
+    {
+        if (t_SizeClassCache == nullptr && !t_IsSizeClassCacheReleased)
+        {
+            t_SizeClassCache = AcquireSizeClassCache();
+            t_SizeClassCacheHolder.m_Cache = t_SizeClassCache;
+        }
+        return t_SizeClassCache;
+    }
+
+    static uint32_t GetSizeClass(size_t size)
+    {
+        uint32_t sizeClass = 0;
+        while ((size_t(1) << (SizeClassCache::MinSizeShift + sizeClass)) < size)
+        {
+            sizeClass++;
+        }
+        return sizeClass;
+    }
+
+    static Span* GetSpan(void* memory)
+    {
+        return reinterpret_cast<Span*>(reinterpret_cast<uintptr_t>(memory) & ~uintptr_t(SizeClassCache::SpanSize - 1));
+    }
+
+    // Blocks are aligned to their size, with the span header taking up the first one.
+    static void CarveSpan(SizeClassCache& cache, uint32_t sizeClass)
+    {
+        static_assert(sizeof(Span) <= (size_t(1) << SizeClassCache::MinSizeShift), "The span header must fit into the smallest block.");
+        const size_t blockSize = size_t(1) << (SizeClassCache::MinSizeShift + sizeClass);
+        uint8_t* spanMemory = static_cast<uint8_t*>(::operator new(SizeClassCache::SpanSize, std::align_val_t(SizeClassCache::SpanSize)));
+        Span* span = new (spanMemory) Span();
+        span->m_Owner = &cache;
+        span->m_SizeClass = sizeClass;
+
+        FreeBlock*& freeList = cache.m_FreeLists[sizeClass];
+        for (size_t offset = SizeClassCache::SpanSize - blockSize; offset >= blockSize; offset -= blockSize)
+        {
+            FreeBlock* block = new (spanMemory + offset) FreeBlock();
+            block->m_Next = freeList;
+            freeList = block;
+        }
+    }
+
+    void* SizeClassCache::Allocate(uint32_t sizeClass)
+    {
+        // Take back whatever other threads freed in the meantime. Those blocks may be of any size class.
+        if (m_FreeLists[sizeClass] == nullptr)
+        {
+            FreeBlock* remoteBlock = m_RemoteFrees.exchange(nullptr, std::memory_order_acquire);
+            while (remoteBlock != nullptr)
+            {
+                FreeBlock* nextBlock = remoteBlock->m_Next;
+                FreeBlock*& freeList = m_FreeLists[GetSpan(remoteBlock)->m_SizeClass];
+                remoteBlock->m_Next = freeList;
+                freeList = remoteBlock;
+                remoteBlock = nextBlock;
+            }
+        }
+
+        if (m_FreeLists[sizeClass] == nullptr)
+        {
+            CarveSpan(*this, sizeClass);
+        }
+
+        FreeBlock* block = m_FreeLists[sizeClass];
+        m_FreeLists[sizeClass] = block->m_Next;
+        return block;
+    }
+
+    void SizeClassCache::Free(void* memory)
+    {
+        FreeBlock* block = static_cast<FreeBlock*>(memory);
+        SizeClassCache* owner = GetSpan(memory)->m_Owner;
+        if (owner == this)
+        {
+            FreeBlock*& freeList = m_FreeLists[GetSpan(memory)->m_SizeClass];
+            block->m_Next = freeList;
+            freeList = block;
+            return;
+        }
+
+        if (owner != m_BatchOwner)
+        {
+            FlushRemoteFreeBatch();
+            m_BatchOwner = owner;
+        }
+
+        block->m_Next = m_BatchHead;
+        m_BatchHead = block;
+        if (m_BatchTail == nullptr)
+        {
+            m_BatchTail = block;
+        }
+
+        if (++m_BatchCount == RemoteFreeBatchSize)
+        {
+            FlushRemoteFreeBatch();
+        }
+    }
+
+    // The owner only ever takes the whole list, so pushing is free of ABA problems.
+    void SizeClassCache::FlushRemoteFreeBatch()
+    {
+        if (m_BatchHead == nullptr)
+        {
+            return;
+        }
+
+        FreeBlock* remoteFrees = m_BatchOwner->m_RemoteFrees.load(std::memory_order_relaxed);
+        do
+        {
+            m_BatchTail->m_Next = remoteFrees;
+        } while (!m_BatchOwner->m_RemoteFrees.compare_exchange_weak(remoteFrees, m_BatchHead, std::memory_order_release, std::memory_order_relaxed));
+
+        m_BatchOwner = nullptr;
+        m_BatchHead = nullptr;
+        m_BatchTail = nullptr;
+        m_BatchCount = 0;
+    }
+
+    void FlushRemoteFrees()
+    {
+        if (t_SizeClassCache != nullptr)
+        {
+            t_SizeClassCache->FlushRemoteFreeBatch();
+        }
+    }
+
+    void* SizeClassAlloc(size_t size)
+    {
+        if (size > SizeClassCache::MaxSize)
+        {
+            return ::operator new(size);
+        }
+
+        const uint32_t sizeClass = GetSizeClass(size);
+        if (SizeClassCache* cache = GetSizeClassCache())
+        {
+            return cache->Allocate(sizeClass);
+        }
+
+        // The thread is exiting and has released its cache already. Borrow one for the allocation.
+        SizeClassCache* borrowedCache = AcquireSizeClassCache();
+        void* memory = borrowedCache->Allocate(sizeClass);
+        ReleaseSizeClassCache(borrowedCache);
+        return memory;
+    }
+
+    void SizeClassFree(void* memory, size_t size)
+    {
+        if (memory == nullptr)
+        {
+            return;
+        }
+
+        if (size > SizeClassCache::MaxSize)
+        {
+            ::operator delete(memory);
+            return;
+        }
+
+        if (SizeClassCache* cache = GetSizeClassCache())
+        {
+            cache->Free(memory);
+            return;
+        }
+
+        SizeClassCache* borrowedCache = AcquireSizeClassCache();
+        borrowedCache->Free(memory);
+        ReleaseSizeClassCache(borrowedCache);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "JobSystem.h"
+
+namespace Cyclone
+{
+    // Backing store of SizeClassAlloc(). Sizes are rounded up to a power of two, and each size class is carved out of 64KB spans aligned to their size,
+    // so the span, and with it the size class and owning cache of any block, is found by masking its address. Every thread allocates from a cache of its own.
+    // Blocks freed by the owner go straight back onto its free lists. Blocks freed by other threads are collected into a batch per owner, which is handed over
+    // with a single atomic push once full, or once the thread goes idle. Owners take back remote frees whole, when a free list runs dry.
+    struct SizeClassCache;
+
+    struct FreeBlock
+    {
+        FreeBlock* m_Next = nullptr;
+    };
+
+    struct Span
+    {
+        SizeClassCache* m_Owner = nullptr;
+        uint32_t m_SizeClass = 0;
+    };
+
+    struct SizeClassCache
+    {
+        static constexpr uint32_t MinSizeShift = 4;
+        static constexpr uint32_t SizeClassCount = 9; // 16 bytes through 4KB.
+        static constexpr size_t MaxSize = size_t(1) << (MinSizeShift + SizeClassCount - 1);
+        static constexpr size_t SpanSize = 64 * 1024;
+        static constexpr uint32_t RemoteFreeBatchSize = 32;
+
+        FreeBlock* m_FreeLists[SizeClassCount] = {};
+        alignas(64) std::atomic<FreeBlock*> m_RemoteFrees = nullptr; // Pushed to by other threads, a batch at a time.
+
+        // Blocks freed by this thread on behalf of another cache, not yet handed over.
+        SizeClassCache* m_BatchOwner = nullptr;
+        FreeBlock* m_BatchHead = nullptr;
+        FreeBlock* m_BatchTail = nullptr;
+        uint32_t m_BatchCount = 0;
+
+        void* Allocate(uint32_t sizeClass);
+        void Free(void* memory);
+        void FlushRemoteFreeBatch();
+    };
+
+    // Hands the blocks freed by this thread on behalf of other threads back to them. Called by workers before going to sleep, so blocks aren't held back
+    // while the worker idles.
+    void FlushRemoteFrees();
+}
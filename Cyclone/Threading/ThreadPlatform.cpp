@@ -0,0 +1,369 @@
+#include "ThreadPlatform.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winerror.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+namespace Cyclone
+{
+    constexpr size_t PrefaultStackSize = 256 * 1024; // Deep enough for any job. Thread stacks are reserved at 1 MB on Windows and 8 MB on Linux.
+    constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+    uint32_t GetHardwareCoreCount()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+#ifdef _WIN32
+    std::vector<uint32_t> GetProcessAffinity()
+    {
+        std::vector<uint32_t> cores;
+        DWORD_PTR processAffinityMask = 0;
+        DWORD_PTR systemAffinityMask = 0;
+        if (GetProcessAffinityMask(GetCurrentProcess(), &processAffinityMask, &systemAffinityMask))
+        {
+            for (uint32_t core = 0; core < 64; core++)
+            {
+                if ((processAffinityMask >> core) & 1)
+                {
+                    cores.push_back(core);
+                }
+            }
+        }
+        return cores;
+    }
+
+    uint32_t GetCPUQuota()
+    {
+        return 0; // Job object CPU rate limits aren't looked at.
+    }
+
+    void SetThreadAffinity(std::thread::native_handle_type threadHandle, uint32_t core)
+    {
+        // Affinity masks only address the 64 cores of the calling processor group.
+        if (core >= 64)
+        {
+            return;
+        }
+
+        DWORD_PTR affinityMask = 1ull << core;
+        DWORD_PTR affinityResult = SetThreadAffinityMask(threadHandle, affinityMask);
+        assert(affinityResult > 0);
+    }
+
+    void SetThreadName(std::thread::native_handle_type threadHandle, Priority priorityType, uint32_t threadIndex)
+    {
+        std::wstring threadName;
+        switch (priorityType)
+        {
+        case Priority::High:
+            threadName = L"Cyclone::HighPriorityJobThread_" + std::to_wstring(threadIndex);
+            break;
+        case Priority::Low:
+            threadName = L"Cyclone::LowPriorityJobThread_" + std::to_wstring(threadIndex);
+            break;
+        default:
+            threadName = L"Cyclone::StreamingLowPriorityJobThread_" + std::to_wstring(threadIndex);
+            break;
+        }
+
+        HRESULT namingResult = SetThreadDescription(threadHandle, threadName.c_str());
+        assert(SUCCEEDED(namingResult));
+    }
+
+    void SetOSThreadPriority(std::thread::native_handle_type threadHandle, Priority priorityType)
+    {
+        BOOL priorityResult = SetThreadPriority(threadHandle, priorityType == Priority::High ? THREAD_PRIORITY_NORMAL : THREAD_PRIORITY_LOWEST);
+        assert(priorityResult != 0);
+    }
+
+    void SetCurrentThreadNiceness(Priority priorityType)
+    {
+        CYCLONE_UNREFERENCED_PARAMETER(priorityType); // Covered by SetOSThreadPriority().
+    }
+
+    // Windows has no FIFO class. Time critical is the highest priority available without moving the whole process to the real-time priority class.
+    bool SetRealTimeThreadPriority(std::thread::native_handle_type threadHandle, int fifoPriority)
+    {
+        CYCLONE_UNREFERENCED_PARAMETER(fifoPriority);
+        return SetThreadPriority(threadHandle, THREAD_PRIORITY_TIME_CRITICAL) != 0;
+    }
+
+    bool LockProcessMemory()
+    {
+        return false; // VirtualLock() only covers given ranges, and is bounded by the working set size.
+    }
+
+    void UnlockProcessMemory()
+    {
+    }
+
+    // VirtualAlloc() hands out untouched pages aligned to 64 KB. Actual large pages need SeLockMemoryPrivilege, and aren't attempted.
+    void* AllocateLargePages(size_t size)
+    {
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    void FreeLargePages(void* memory, size_t size)
+    {
+        CYCLONE_UNREFERENCED_PARAMETER(size);
+        if (memory != nullptr)
+        {
+            VirtualFree(memory, 0, MEM_RELEASE);
+        }
+    }
+
+    void PrefaultCurrentThreadStack()
+    {
+        // Windows commits stacks through a guard page, one page at a time.
+        char stack[PrefaultStackSize];
+        volatile char* stackBytes = stack; // Keeps the writes from being optimized away.
+        for (size_t offset = 0; offset < PrefaultStackSize; offset += 4096)
+        {
+            stackBytes[offset] = 0;
+        }
+    }
+#else
+    std::vector<uint32_t> GetProcessAffinity()
+    {
+        // The set has to be large enough for every core the kernel knows of, so grow it until the call stops failing.
+        std::vector<uint32_t> cores;
+        for (uint32_t coreCapacity = 1024; coreCapacity <= 1024 * 1024; coreCapacity *= 2)
+        {
+            cpu_set_t* coreSet = CPU_ALLOC(coreCapacity);
+            const size_t coreSetSize = CPU_ALLOC_SIZE(coreCapacity);
+            CPU_ZERO_S(coreSetSize, coreSet);
+            const bool isRetrieved = sched_getaffinity(0, coreSetSize, coreSet) == 0;
+            if (isRetrieved)
+            {
+                for (uint32_t core = 0; core < coreCapacity; core++)
+                {
+                    if (CPU_ISSET_S(core, coreSetSize, coreSet))
+                    {
+                        cores.push_back(core);
+                    }
+                }
+            }
+            CPU_FREE(coreSet);
+
+            if (isRetrieved || errno != EINVAL)
+            {
+                break;
+            }
+        }
+        return cores;
+    }
+
+    // Finds the group of the process in /proc/self/cgroup, whose lines read "ID:controllers:path". The single cgroup v2 hierarchy lists no controllers.
+    static bool FindCgroupPath(const std::string& controller, std::string& cgroupPath)
+    {
+        std::ifstream file("/proc/self/cgroup");
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const size_t controllersBegin = line.find(':');
+            const size_t pathBegin = controllersBegin == std::string::npos ? std::string::npos : line.find(':', controllersBegin + 1);
+            if (pathBegin == std::string::npos)
+            {
+                continue;
+            }
+
+            const std::string controllers = line.substr(controllersBegin + 1, pathBegin - controllersBegin - 1);
+            if (controller.empty() ? controllers.empty() : ("," + controllers + ",").find("," + controller + ",") != std::string::npos)
+            {
+                cgroupPath = line.substr(pathBegin + 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Calls the visitor with the directory of the group and each of its parents, up to the root of the hierarchy.
+    // Within containers, the path of the group may be relative to a hierarchy root that isn't visible, in which case only the mounted root is found.
+    template<typename Visitor>
+    static void VisitCgroupDirectories(const std::string& mountPoint, std::string cgroupPath, const Visitor& visitor)
+    {
+        while (true)
+        {
+            visitor(mountPoint + cgroupPath + "/");
+            const size_t separator = cgroupPath.rfind('/');
+            if (separator == std::string::npos || cgroupPath.empty())
+            {
+                return;
+            }
+            cgroupPath = cgroupPath.substr(0, separator);
+        }
+    }
+
+    uint32_t GetCPUQuota()
+    {
+        uint32_t quota = 0;
+        auto applyQuota = [&quota](long long quotaMicroseconds, long long periodMicroseconds)
+        {
+            if (quotaMicroseconds > 0 && periodMicroseconds > 0)
+            {
+                const uint32_t quotaCores = (uint32_t)std::max(1ll, (quotaMicroseconds + periodMicroseconds - 1) / periodMicroseconds);
+                quota = quota == 0 ? quotaCores : std::min(quota, quotaCores);
+            }
+        };
+
+        std::string cgroupPath;
+        if (FindCgroupPath("", cgroupPath))
+        {
+            VisitCgroupDirectories("/sys/fs/cgroup", cgroupPath, [&](const std::string& cgroupDirectory)
+            {
+                // Reads "max 100000" while unlimited.
+                std::ifstream file(cgroupDirectory + "cpu.max");
+                std::string quotaMicroseconds;
+                long long periodMicroseconds = 0;
+                if (file >> quotaMicroseconds >> periodMicroseconds && quotaMicroseconds != "max")
+                {
+                    applyQuota(atoll(quotaMicroseconds.c_str()), periodMicroseconds);
+                }
+            });
+        }
+
+        if (FindCgroupPath("cpu", cgroupPath))
+        {
+            for (const char* mountPoint : { "/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct" })
+            {
+                VisitCgroupDirectories(mountPoint, cgroupPath, [&](const std::string& cgroupDirectory)
+                {
+                    // The quota reads -1 while unlimited.
+                    std::ifstream quotaFile(cgroupDirectory + "cpu.cfs_quota_us");
+                    std::ifstream periodFile(cgroupDirectory + "cpu.cfs_period_us");
+                    long long quotaMicroseconds = 0;
+                    long long periodMicroseconds = 0;
+                    if (quotaFile >> quotaMicroseconds && periodFile >> periodMicroseconds)
+                    {
+                        applyQuota(quotaMicroseconds, periodMicroseconds);
+                    }
+                });
+            }
+        }
+        return quota;
+    }
+
+    void SetThreadAffinity(std::thread::native_handle_type threadHandle, uint32_t core)
+    {
+        // Dynamically sized, so machines with more than CPU_SETSIZE cores can be addressed too.
+        cpu_set_t* coreSet = CPU_ALLOC(core + 1);
+        const size_t coreSetSize = CPU_ALLOC_SIZE(core + 1);
+        CPU_ZERO_S(coreSetSize, coreSet);
+        CPU_SET_S(core, coreSetSize, coreSet);
+
+        // Fails if the core is outside of the cores the process is allowed on, such as within a container. The worker then keeps floating.
+        pthread_setaffinity_np(threadHandle, coreSetSize, coreSet);
+        CPU_FREE(coreSet);
+    }
+
+    void SetThreadName(std::thread::native_handle_type threadHandle, Priority priorityType, uint32_t threadIndex)
+    {
+        // Names are limited to 15 characters, so the ones used on Windows don't fit.
+        const char* poolName = priorityType == Priority::High ? "High" : priorityType == Priority::Low ? "Low" : "Stream";
+        char threadName[16] = {};
+        snprintf(threadName, sizeof(threadName), "Cyclone%s_%u", poolName, threadIndex);
+        pthread_setname_np(threadHandle, threadName);
+    }
+
+    // High priority workers are regular threads. Lower priorities are marked as batch work, which the kernel preempts less eagerly
+    // in favour of interactive threads. Switching back to SCHED_OTHER needs no privileges, so boosting always succeeds.
+    void SetOSThreadPriority(std::thread::native_handle_type threadHandle, Priority priorityType)
+    {
+        const sched_param schedulingParameters = {};
+        pthread_setschedparam(threadHandle, priorityType == Priority::High ? SCHED_OTHER : SCHED_BATCH, &schedulingParameters);
+    }
+
+    void SetCurrentThreadNiceness(Priority priorityType)
+    {
+        constexpr int lowPriorityNiceness = 5;
+        if (priorityType != Priority::High)
+        {
+            setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), lowPriorityNiceness);
+        }
+    }
+
+    bool SetRealTimeThreadPriority(std::thread::native_handle_type threadHandle, int fifoPriority)
+    {
+        sched_param schedulingParameters = {};
+        schedulingParameters.sched_priority = std::clamp(fifoPriority, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+        return pthread_setschedparam(threadHandle, SCHED_FIFO, &schedulingParameters) == 0;
+    }
+
+    bool LockProcessMemory()
+    {
+        return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    }
+
+    void UnlockProcessMemory()
+    {
+        munlockall();
+    }
+
+    static size_t RoundUpToHugePage(size_t size)
+    {
+        return (size + HugePageSize - 1) & ~(HugePageSize - 1);
+    }
+
+    // Mapped directly rather than through malloc(), which may hand out pages already touched by a previous allocation. The mapping is over-allocated
+    // by a huge page and trimmed to huge page alignment, as transparent huge pages only back aligned 2 MB ranges.
+    void* AllocateLargePages(size_t size)
+    {
+        const size_t alignedSize = RoundUpToHugePage(size);
+        char* mapping = static_cast<char*>(mmap(nullptr, alignedSize + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (mapping == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        char* memory = reinterpret_cast<char*>(RoundUpToHugePage(reinterpret_cast<uintptr_t>(mapping)));
+        if (memory != mapping)
+        {
+            munmap(mapping, memory - mapping);
+        }
+        const size_t trailingSize = (mapping + alignedSize + HugePageSize) - (memory + alignedSize);
+        if (trailingSize > 0)
+        {
+            munmap(memory + alignedSize, trailingSize);
+        }
+
+        madvise(memory, alignedSize, MADV_HUGEPAGE); // Only a hint. Fails harmlessly where transparent huge pages are disabled.
+        return memory;
+    }
+
+    void FreeLargePages(void* memory, size_t size)
+    {
+        if (memory != nullptr)
+        {
+            munmap(memory, RoundUpToHugePage(size));
+        }
+    }
+
+    void PrefaultCurrentThreadStack()
+    {
+        const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        char stack[PrefaultStackSize];
+        volatile char* stackBytes = stack; // Keeps the writes from being optimized away.
+        for (size_t offset = 0; offset < PrefaultStackSize; offset += pageSize)
+        {
+            stackBytes[offset] = 0;
+        }
+    }
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "JobSystem.h"
+
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace Cyclone
+{
+    // Thin layer over the OS threading APIs used to place, name and prioritize workers. Backed by Win32 on Windows and pthreads on Linux.
+    // These are all hints to the OS scheduler. A worker that couldn't be pinned or named still executes jobs, so failures are not reported.
+
+    // Number of logical cores present, never less than one.
+    uint32_t GetHardwareCoreCount();
+
+    // Logical cores the process may run on, as inherited from its parent or set by taskset and container runtimes. Empty if unknown.
+    std::vector<uint32_t> GetProcessAffinity();
+
+    // CPU time the process may use per period, as the number of cores it amounts to, rounded up. Set through the cpu.max file of cgroup v2,
+    // or the cfs_quota_us and cfs_period_us files of cgroup v1, including those of any parent group. Zero if there is no quota.
+    uint32_t GetCPUQuota();
+
+    // Pins the thread to a single logical core.
+    void SetThreadAffinity(std::thread::native_handle_type threadHandle, uint32_t core);
+
+    // Names the thread after its pool, as shown by debuggers and profilers.
+    void SetThreadName(std::thread::native_handle_type threadHandle, Priority priorityType, uint32_t threadIndex);
+
+    // Maps the priority onto the scheduling class of the thread. Callable from any thread, so waiters can boost the workers executing their jobs.
+    void SetOSThreadPriority(std::thread::native_handle_type threadHandle, Priority priorityType);
+
+    // Applies the niceness of the priority to the calling thread. Linux only keeps niceness per thread, and it can only be addressed from the thread itself.
+    // Raising it back requires CAP_SYS_NICE, so unlike SetOSThreadPriority() this is applied once when a worker starts, and not when it is boosted.
+    void SetCurrentThreadNiceness(Priority priorityType);
+
+    // Moves the thread into the real-time FIFO class, ahead of every regular thread. Returns false if the process lacks the privileges for it,
+    // in which case the thread keeps its scheduling. SetOSThreadPriority() returns it to the regular class.
+    bool SetRealTimeThreadPriority(std::thread::native_handle_type threadHandle, int fifoPriority);
+
+    // Locks every current and future page of the process into memory. Returns false if the process lacks the privileges or the memory lock limit for it.
+    bool LockProcessMemory();
+    void UnlockProcessMemory();
+
+    // Touches the stack of the calling thread below the current frame, so that running jobs never take a page fault growing it.
+    void PrefaultCurrentThreadStack();
+
+    // Tells the core that the caller is spinning, which frees up resources for its SMT sibling and avoids a pipeline flush once the spin ends.
+    inline void CPURelax()
+    {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+}
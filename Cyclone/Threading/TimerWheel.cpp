@@ -0,0 +1,159 @@
+#include "TimerWheel.h"
+
+namespace Cyclone
+{
+    // Rounds up, so a timer never fires before its expiry.
+    uint64_t TimerWheel::GetTick(TimePoint timePoint) const
+    {
+        if (timePoint <= m_Epoch)
+        {
+            return 0;
+        }
+        return (uint64_t)((timePoint - m_Epoch + TickDuration - Duration(1)) / TickDuration);
+    }
+
+    void TimerWheel::Insert(Timer&& timer)
+    {
+        // Expects timer.m_ExpiryTick >= m_CurrentTick. Cascaded timers due in the current tick land in the level 0 slot about to be serviced.
+        const uint64_t expiryTick = timer.m_ExpiryTick;
+        const uint64_t tickDelta = expiryTick - m_CurrentTick;
+
+        for (uint32_t level = 0; level < LevelCount; level++)
+        {
+            const uint32_t levelShift = SlotBits * (level + 1);
+            if (tickDelta < (1ull << levelShift))
+            {
+                m_Slots[level][(expiryTick >> (SlotBits * level)) & (SlotCount - 1)].push_back(std::move(timer));
+                return;
+            }
+        }
+
+        // Beyond the range of the wheel. Park it in the furthest slot of the top level, where it will be cascaded and reinserted from.
+        const uint32_t topLevel = LevelCount - 1;
+        const uint64_t furthestTick = m_CurrentTick + (1ull << (SlotBits * LevelCount)) - 1;
+        m_Slots[topLevel][(furthestTick >> (SlotBits * topLevel)) & (SlotCount - 1)].push_back(std::move(timer));
+    }
+
+    void TimerWheel::UpdateNextExpiry()
+    {
+        uint64_t nextTick = ~0ull;
+        if (!m_ActiveTimers.empty())
+        {
+            for (uint32_t level = 0; level < LevelCount; level++)
+            {
+                const uint32_t levelShift = SlotBits * level;
+                for (uint64_t slotOffset = 1; slotOffset <= SlotCount; slotOffset++)
+                {
+                    // Level 0 slots expire at their tick. Upper level slots cascade at the start of their range, which is when their timers may start to expire.
+                    const uint64_t slotTick = ((m_CurrentTick >> levelShift) + slotOffset) << levelShift;
+                    if (!m_Slots[level][(slotTick >> levelShift) & (SlotCount - 1)].empty())
+                    {
+                        nextTick = std::min(nextTick, slotTick);
+                        break;
+                    }
+                }
+            }
+        }
+
+        const TimePoint nextExpiry = nextTick == ~0ull ? NoDeadline : m_Epoch + TickDuration * (Duration::rep)nextTick;
+        m_NextExpiry.store(nextExpiry.time_since_epoch().count());
+    }
+
+    TimerID TimerWheel::Schedule(TimePoint expiry, Duration period, Callback callback)
+    {
+        std::scoped_lock lock(m_WheelLock);
+
+        Timer timer;
+        timer.m_TimerID = m_NextTimerID++;
+        timer.m_ExpiryTick = std::max(GetTick(expiry), m_CurrentTick + 1); // Timers already due are placed in the very next tick.
+        timer.m_Period = period;
+        timer.m_Callback = std::move(callback);
+
+        const TimerID timerID = timer.m_TimerID;
+        m_ActiveTimers.insert(timerID);
+        Insert(std::move(timer));
+        UpdateNextExpiry();
+        return timerID;
+    }
+
+    // Cancelled timers are left in their slots and dropped once their slot comes up.
+    void TimerWheel::Cancel(TimerID timerID)
+    {
+        std::scoped_lock lock(m_WheelLock);
+        m_ActiveTimers.erase(timerID);
+    }
+
+    bool TimerWheel::Service(TimePoint currentTime, CallbackList& dueCallbacks)
+    {
+        std::unique_lock<std::mutex> lock(m_WheelLock, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            return false;
+        }
+
+        // Only ticks that have fully elapsed are serviced.
+        const uint64_t targetTick = currentTime > m_Epoch ? (uint64_t)((currentTime - m_Epoch) / TickDuration) : 0;
+        if (m_ActiveTimers.empty())
+        {
+            m_CurrentTick = std::max(m_CurrentTick, targetTick); // Nothing to expire, so skip over the idle period entirely.
+        }
+
+        TimerList slotTimers;
+        while (m_CurrentTick < targetTick)
+        {
+            m_CurrentTick++;
+
+            // Whenever a level wraps around, the next slot of the level above is redistributed into the levels below it.
+            for (uint32_t level = 1; level < LevelCount; level++)
+            {
+                const uint32_t levelShift = SlotBits * level;
+                if ((m_CurrentTick & ((1ull << levelShift) - 1)) != 0)
+                {
+                    break;
+                }
+
+                slotTimers.swap(m_Slots[level][(m_CurrentTick >> levelShift) & (SlotCount - 1)]);
+                for (Timer& timer : slotTimers)
+                {
+                    if (m_ActiveTimers.count(timer.m_TimerID) > 0)
+                    {
+                        Insert(std::move(timer));
+                    }
+                }
+                slotTimers.clear();
+            }
+
+            slotTimers.swap(m_Slots[0][m_CurrentTick & (SlotCount - 1)]);
+            for (Timer& timer : slotTimers)
+            {
+                if (m_ActiveTimers.count(timer.m_TimerID) == 0)
+                {
+                    continue;
+                }
+
+                if (timer.m_Period > Duration::zero())
+                {
+                    dueCallbacks.push_back(timer.m_Callback);
+
+                    // Periodic timers keep their phase. If we fell behind by more than a period, the missed expiries are skipped rather than fired in a burst.
+                    const uint64_t periodTicks = std::max<uint64_t>(1, (uint64_t)((timer.m_Period + TickDuration - Duration(1)) / TickDuration));
+                    timer.m_ExpiryTick += periodTicks;
+                    if (timer.m_ExpiryTick <= targetTick)
+                    {
+                        timer.m_ExpiryTick += ((targetTick - timer.m_ExpiryTick) / periodTicks + 1) * periodTicks;
+                    }
+                    Insert(std::move(timer));
+                }
+                else
+                {
+                    dueCallbacks.push_back(std::move(timer.m_Callback));
+                    m_ActiveTimers.erase(timer.m_TimerID);
+                }
+            }
+            slotTimers.clear();
+        }
+
+        UpdateNextExpiry();
+        return true;
+    }
+}
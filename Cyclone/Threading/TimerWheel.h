@@ -0,0 +1,79 @@
+#pragma once
+#include "JobSystem.h"
+
+#include <mutex>
+#include <vector>
+#include <unordered_set>
+
+namespace Cyclone
+{
+    // Hierarchical timing wheel backing ExecuteAfter() and ExecuteEvery(). Timers are hashed into slots by their expiry tick.
+    // Level 0 covers the next 64 ticks, and each level above covers 64 times the range of the one below. As time advances, the slots of
+    // upper levels are cascaded down, so inserting, cancelling and expiring a timer are all constant time no matter how many are pending.
+    struct TimerWheel
+    {
+        static constexpr uint32_t LevelCount = 4;
+        static constexpr uint32_t SlotBits = 6;
+        static constexpr uint32_t SlotCount = 1 << SlotBits;
+        static constexpr Duration TickDuration = std::chrono::milliseconds(1);
+
+        // Type erased like std::function, but the callable lives in the same size class block as the reference count rather than on the global heap.
+        struct CallbackBase
+        {
+            virtual ~CallbackBase() = default;
+            virtual void Invoke() = 0; // Timers that fire once may move from their callable.
+        };
+
+        template<typename Callable>
+        struct CallbackOf final : CallbackBase
+        {
+            Callable m_Callable;
+
+            explicit CallbackOf(Callable&& callable) : m_Callable(std::move(callable)) { }
+            void Invoke() override { m_Callable(); }
+        };
+
+        // Shared between the timer and the due lists it is collected into, so periodic timers don't copy their callback each time they fire.
+        using Callback = std::shared_ptr<CallbackBase>;
+
+        template<typename Callable>
+        static Callback MakeCallback(Callable callable)
+        {
+            return std::allocate_shared<CallbackOf<Callable>>(SizeClassAllocator<CallbackOf<Callable>>(), std::move(callable));
+        }
+
+        struct Timer
+        {
+            TimerID m_TimerID = 0;
+            uint64_t m_ExpiryTick = 0;
+            Duration m_Period = Duration::zero(); // Zero for timers that fire once.
+            Callback m_Callback;
+        };
+
+        // Timers move between slots serviced by whichever thread gets to the wheel, so slots allocate from the size class caches. See SizeClassAlloc().
+        using TimerList = std::vector<Timer, SizeClassAllocator<Timer>>;
+        using CallbackList = std::vector<Callback, SizeClassAllocator<Callback>>;
+
+        TimePoint m_Epoch = std::chrono::steady_clock::now();
+        uint64_t m_CurrentTick = 0;  // All ticks up to and including this one have been serviced.
+        TimerList m_Slots[LevelCount][SlotCount];
+        std::unordered_set<TimerID, std::hash<TimerID>, std::equal_to<TimerID>, SizeClassAllocator<TimerID>> m_ActiveTimers;
+        TimerID m_NextTimerID = 1;
+        std::mutex m_WheelLock;
+        std::atomic<TimePoint::rep> m_NextExpiry = NoDeadline.time_since_epoch().count(); // Conservative estimate, readable without the lock.
+
+        TimerID Schedule(TimePoint expiry, Duration period, Callback callback);
+        void Cancel(TimerID timerID);
+
+        // Collects the callbacks of every timer due by the given time, rescheduling periodic ones. The callbacks are to be invoked by the caller, outside the lock.
+        // Returns false without blocking if another thread is already servicing the wheel.
+        bool Service(TimePoint currentTime, CallbackList& dueCallbacks);
+
+        // The earliest time at which Service() may find a due timer. May be earlier than the actual next expiry, but never later.
+        TimePoint GetNextExpiry() const { return TimePoint(Duration(m_NextExpiry.load())); }
+
+        uint64_t GetTick(TimePoint timePoint) const;
+        void Insert(Timer&& timer);
+        void UpdateNextExpiry();
+    };
+}
@@ -0,0 +1,233 @@
+#include "Topology.h"
+#include "ThreadPlatform.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+
+namespace Cyclone
+{
+    // Cores below this share of the fastest core's capacity count as efficiency cores. Loose enough that favored cores boosting slightly higher
+    // than their peers aren't mistaken for a separate class.
+    constexpr uint32_t EfficiencyCapacityPercent = 85;
+
+    constexpr const char* DefaultTopologyRoot = "/sys/devices/system";
+
+    std::string g_TopologyRoot = DefaultTopologyRoot;
+    std::mutex g_TopologyRootLock;
+
+    void SetTopologyRoot(const std::string& sysfsRoot)
+    {
+        std::scoped_lock lock(g_TopologyRootLock);
+        g_TopologyRoot = sysfsRoot;
+    }
+
+    std::string GetTopologyRoot()
+    {
+        std::scoped_lock lock(g_TopologyRootLock);
+        return g_TopologyRoot;
+    }
+
+    static bool ReadLine(const std::string& filePath, std::string& line)
+    {
+        std::ifstream file(filePath);
+        return file.is_open() && std::getline(file, line) && !line.empty();
+    }
+
+    // Parses the list format used throughout sysfs, such as "0-3,8,10-11". Malformed lists come back empty, as if the file was missing.
+    static std::vector<uint32_t> ParseCoreList(const std::string& coreList)
+    {
+        std::vector<uint32_t> cores;
+        std::stringstream listStream(coreList);
+        std::string range;
+        while (std::getline(listStream, range, ','))
+        {
+            char* rangeEnd = nullptr;
+            const uint32_t first = (uint32_t)strtoul(range.c_str(), &rangeEnd, 10);
+            uint32_t last = first;
+            if (rangeEnd == range.c_str())
+            {
+                return {};
+            }
+            if (*rangeEnd == '-')
+            {
+                const char* lastBegin = rangeEnd + 1;
+                last = (uint32_t)strtoul(lastBegin, &rangeEnd, 10);
+                if (rangeEnd == lastBegin || last < first)
+                {
+                    return {};
+                }
+            }
+
+            for (uint32_t core = first; core <= last; core++)
+            {
+                cores.push_back(core);
+            }
+        }
+        return cores;
+    }
+
+    static std::vector<uint32_t> ReadCoreList(const std::string& filePath)
+    {
+        std::string line;
+        return ReadLine(filePath, line) ? ParseCoreList(line) : std::vector<uint32_t>();
+    }
+
+    static uint32_t ReadNumber(const std::string& filePath, uint32_t fallback)
+    {
+        std::string line;
+        char* numberEnd = nullptr;
+        const uint32_t number = ReadLine(filePath, line) ? (uint32_t)strtoul(line.c_str(), &numberEnd, 10) : 0;
+        return numberEnd != nullptr && numberEnd != line.c_str() ? number : fallback;
+    }
+
+    void Topology::Discover(const std::string& sysfsRoot)
+    {
+        m_LogicalCores.clear();
+        m_IsMachineTopology = sysfsRoot == DefaultTopologyRoot;
+
+        const std::string cpuRoot = sysfsRoot + "/cpu/";
+        std::vector<uint32_t> onlineCores = ReadCoreList(cpuRoot + "online");
+        if (onlineCores.empty())
+        {
+            for (uint32_t core = 0; core < GetHardwareCoreCount(); core++)
+            {
+                m_LogicalCores.push_back({ core, core, 0, 0, 0 });
+            }
+            return;
+        }
+
+        for (uint32_t core : onlineCores)
+        {
+            const std::string coreRoot = cpuRoot + "cpu" + std::to_string(core) + "/";
+
+            LogicalCore logicalCore;
+            logicalCore.m_Core = core;
+            logicalCore.m_PackageID = ReadNumber(coreRoot + "topology/physical_package_id", 0);
+
+            // Kernels set cpu_capacity on hybrid machines, scaled to 1024 for the fastest core. Otherwise, the max frequency is the best hint we have.
+            logicalCore.m_Capacity = ReadNumber(coreRoot + "cpu_capacity", 0);
+            if (logicalCore.m_Capacity == 0)
+            {
+                logicalCore.m_Capacity = ReadNumber(coreRoot + "cpufreq/cpuinfo_max_freq", 0);
+            }
+
+            const std::vector<uint32_t> siblings = ReadCoreList(coreRoot + "topology/thread_siblings_list");
+            logicalCore.m_PhysicalCoreID = siblings.empty() ? core : siblings.front();
+
+            // Without an L3, cores are treated as sharing one per socket. IDs from the top of the range keep these apart from actual cores.
+            logicalCore.m_L3ID = ~0u - logicalCore.m_PackageID;
+            for (uint32_t cacheIndex = 0; ; cacheIndex++)
+            {
+                const std::string cacheRoot = coreRoot + "cache/index" + std::to_string(cacheIndex) + "/";
+                const uint32_t cacheLevel = ReadNumber(cacheRoot + "level", 0);
+                if (cacheLevel == 0)
+                {
+                    break;
+                }
+
+                const std::vector<uint32_t> sharingCores = ReadCoreList(cacheRoot + "shared_cpu_list");
+                if (cacheLevel == 3 && !sharingCores.empty())
+                {
+                    logicalCore.m_L3ID = sharingCores.front();
+                    break;
+                }
+            }
+            m_LogicalCores.push_back(logicalCore);
+        }
+
+        // Machines without NUMA expose no node directory, leaving every core on node 0.
+        const std::string nodeRoot = sysfsRoot + "/node/";
+        for (uint32_t nodeID : ReadCoreList(nodeRoot + "online"))
+        {
+            for (uint32_t core : ReadCoreList(nodeRoot + "node" + std::to_string(nodeID) + "/cpulist"))
+            {
+                for (LogicalCore& logicalCore : m_LogicalCores)
+                {
+                    if (logicalCore.m_Core == core)
+                    {
+                        logicalCore.m_NodeID = nodeID;
+                    }
+                }
+            }
+        }
+
+        uint32_t maxCapacity = 0;
+        for (const LogicalCore& logicalCore : m_LogicalCores)
+        {
+            maxCapacity = std::max(maxCapacity, logicalCore.m_Capacity);
+        }
+        for (LogicalCore& logicalCore : m_LogicalCores)
+        {
+            logicalCore.m_IsEfficiencyCore = logicalCore.m_Capacity != 0 && (uint64_t)logicalCore.m_Capacity * 100 < (uint64_t)maxCapacity * EfficiencyCapacityPercent;
+        }
+
+        std::sort(m_LogicalCores.begin(), m_LogicalCores.end(), [](const LogicalCore& a, const LogicalCore& b)
+        {
+            return std::tie(a.m_PackageID, a.m_NodeID, a.m_L3ID, a.m_PhysicalCoreID, a.m_Core) < std::tie(b.m_PackageID, b.m_NodeID, b.m_L3ID, b.m_PhysicalCoreID, b.m_Core);
+        });
+    }
+
+    const Topology::LogicalCore* Topology::Find(uint32_t core) const
+    {
+        for (const LogicalCore& logicalCore : m_LogicalCores)
+        {
+            if (logicalCore.m_Core == core)
+            {
+                return &logicalCore;
+            }
+        }
+        return nullptr;
+    }
+
+    // Core, L3 and node IDs are unique across sockets, so they can be compared directly.
+    Topology::Distance Topology::GetDistance(uint32_t coreA, uint32_t coreB) const
+    {
+        if (coreA == coreB)
+        {
+            return Distance::SameCore;
+        }
+        const LogicalCore* a = Find(coreA);
+        const LogicalCore* b = Find(coreB);
+        if (a == nullptr || b == nullptr)
+        {
+            return Distance::Remote;
+        }
+        return GetDistance(*a, *b);
+    }
+
+    Topology::Distance Topology::GetDistance(const LogicalCore& a, const LogicalCore& b)
+    {
+        if (a.m_Core == b.m_Core)
+        {
+            return Distance::SameCore;
+        }
+        // Without NUMA information every core reports node 0, so the node alone can't tell whether two cores share a socket.
+        if (a.m_PackageID != b.m_PackageID)
+        {
+            return Distance::Remote;
+        }
+        if (a.m_PhysicalCoreID == b.m_PhysicalCoreID)
+        {
+            return Distance::SamePhysicalCore;
+        }
+        if (a.m_L3ID == b.m_L3ID)
+        {
+            return Distance::SameL3;
+        }
+        if (a.m_NodeID == b.m_NodeID)
+        {
+            return Distance::SameNode;
+        }
+        return Distance::SamePackage;
+    }
+
+    bool Topology::IsEfficiencyCore(uint32_t core) const
+    {
+        const LogicalCore* logicalCore = Find(core);
+        return logicalCore != nullptr && logicalCore->m_IsEfficiencyCore;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "JobSystem.h"
+
+#include <string>
+#include <vector>
+
+namespace Cyclone
+{
+    // CPU topology of the machine: which logical cores are SMT siblings, which share an L3 and which sit on the same NUMA node and socket.
+    // On hybrid CPUs, cores also differ in how fast they are, telling performance cores apart from efficiency cores.
+    // Read from sysfs on Linux. Elsewhere, or if sysfs is missing, the topology is flat: every logical core is a physical core of its own, all sharing one L3 and node.
+    struct Topology
+    {
+        struct LogicalCore
+        {
+            uint32_t m_Core = 0;            // Logical core number, as used for affinity.
+            uint32_t m_PhysicalCoreID = 0;  // Lowest logical core among the SMT siblings of this one.
+            uint32_t m_L3ID = 0;            // Lowest logical core among those sharing the L3 of this one.
+            uint32_t m_NodeID = 0;          // NUMA node.
+            uint32_t m_PackageID = 0;       // Socket.
+            uint32_t m_Capacity = 0;        // Relative speed, from cpu_capacity or else the max frequency in kHz. Only comparable between cores of one machine. Zero if unknown.
+            bool m_IsEfficiencyCore = false; // Notably slower than the fastest cores. Never set on machines whose cores are all alike.
+        };
+
+        // How much two logical cores share, from closest to furthest apart.
+        enum class Distance
+        {
+            SameCore,
+            SamePhysicalCore,
+            SameL3,
+            SameNode,
+            SamePackage,
+            Remote
+        };
+
+        std::vector<LogicalCore> m_LogicalCores; // Online cores, sorted so that cores sharing the most are adjacent.
+        bool m_IsMachineTopology = true;         // False if read from a tree other than the one of this machine, such as a fake one, whose cores mean nothing to the OS.
+
+        // SysfsRoot    - Directory holding the cpu and node directories, normally /sys/devices/system.
+        void Discover(const std::string& sysfsRoot);
+
+        const LogicalCore* Find(uint32_t core) const;
+        Distance GetDistance(uint32_t coreA, uint32_t coreB) const;
+        static Distance GetDistance(const LogicalCore& a, const LogicalCore& b); // For cores looked up with Find() already.
+        bool IsEfficiencyCore(uint32_t core) const;
+    };
+
+    // Root passed to Topology::Discover() by schedulers. See SetTopologyRoot().
+    std::string GetTopologyRoot();
+}